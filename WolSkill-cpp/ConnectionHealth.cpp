@@ -0,0 +1,50 @@
+#include "ConnectionHealth.h"
+
+static constexpr double FAST_WEIGHT = 0.5;
+static constexpr double SLOW_WEIGHT = 0.1;
+static constexpr uint32_t MIN_TREND_SAMPLES = 3;
+static constexpr double TREND_FLOOR_MS = 300.0;  // Below this an RTT rise is not worth acting on
+static constexpr double HIGH_RTT_MS = 2000.0;
+
+void ConnectionHealth::Reset() {
+    *this = ConnectionHealth();
+}
+
+void ConnectionHealth::OnProbeSent(ULONGLONG now) {
+    if (m_probeSentAt) {
+        // Keep timing the older report until it is either answered or declared missed
+        if (now - m_probeSentAt < kPongTimeoutMs) return;
+        ++m_missed;
+    }
+    m_probeSentAt = now;
+}
+
+void ConnectionHealth::OnPong(ULONGLONG now) {
+    if (!m_probeSentAt) return;
+    ULONGLONG rtt = now - m_probeSentAt;
+    m_probeSentAt = 0;
+
+    if (rtt >= kPongTimeoutMs) {
+        ++m_missed;
+        return;
+    }
+    if (m_missed) --m_missed;
+
+    double sample = static_cast<double>(rtt);
+    if (m_samples++ == 0) {
+        m_fastRttMs = m_slowRttMs = sample;
+    } else {
+        m_fastRttMs += FAST_WEIGHT * (sample - m_fastRttMs);
+        m_slowRttMs += SLOW_WEIGHT * (sample - m_slowRttMs);
+    }
+}
+
+int ConnectionHealth::Score() const {
+    int score = 100 - 60 * static_cast<int>(m_missed);
+    if (m_samples >= MIN_TREND_SAMPLES && m_fastRttMs > TREND_FLOOR_MS &&
+        m_fastRttMs > 2.0 * m_slowRttMs)
+        score -= 40;
+    if (m_fastRttMs > HIGH_RTT_MS)
+        score -= 50;
+    return score < 0 ? 0 : score;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <Windows.h>
+#include <cstdint>
+
+// Scores a connection from the round trip of reports to their pong replies.
+//
+// A fast and a slow moving average of the RTT expose a worsening trend, and a
+// report whose pong has not arrived within kPongTimeoutMs counts as missed.
+// Not thread-safe; the owner serializes access.
+class ConnectionHealth {
+public:
+    static constexpr ULONGLONG kPongTimeoutMs = 5000;
+    static constexpr int kDegradedScore = 50;
+
+    void Reset();
+    void OnProbeSent(ULONGLONG now);
+    void OnPong(ULONGLONG now);
+
+    // 100 = healthy, 0 = unusable
+    int Score() const;
+    bool IsDegraded() const { return Score() < kDegradedScore; }
+
+    double FastRttMs() const { return m_fastRttMs; }
+    double SlowRttMs() const { return m_slowRttMs; }
+    uint32_t MissedPongs() const { return m_missed; }
+
+private:
+    ULONGLONG m_probeSentAt = 0; // 0 when no report is awaiting its pong
+    double m_fastRttMs = 0.0;
+    double m_slowRttMs = 0.0;
+    uint32_t m_samples = 0;
+    uint32_t m_missed = 0;       // Recent misses; each on-time pong forgives one
+};
@@ -0,0 +1,122 @@
+#include "ConnectionLifecycle.h"
+#include "Log.h"
+
+void ConnectionLifecycle::SendReport() {
+    m_transport.SendReport();
+    m_lastSendTick = m_clock.Now();
+}
+
+// Report timer and pong deadline, both coalescable with the scheduler's tolerance
+void ConnectionLifecycle::ArmHeartbeatTimers() {
+    ULONG tolerance = m_scheduler.ToleranceMs();
+    m_clock.Arm(Timer::Heartbeat, m_scheduler.HeartbeatTimeoutMs(), tolerance);
+    m_clock.Arm(Timer::Report, m_scheduler.ReportIntervalMs(), tolerance);
+}
+
+void ConnectionLifecycle::CancelTimers() {
+    m_clock.Cancel(Timer::Probe);
+    m_clock.Cancel(Timer::Heartbeat);
+    m_clock.Cancel(Timer::Report);
+}
+
+void ConnectionLifecycle::OnConnected() {
+    // Send MACs immediately, start heartbeat
+    m_connected = true;
+    m_localStop = false;
+    if (m_networkEventTick) {
+        LOG_INFO("Connected {} ms after network change/resume", m_clock.Now() - m_networkEventTick);
+        m_networkEventTick = 0;
+    }
+    SendReport();
+    ArmHeartbeatTimers();
+}
+
+void ConnectionLifecycle::OnDisconnected() {
+    // A server-side close while we were quiet tells us the gateway idle timeout
+    if (m_connected && !m_localStop && m_lastSendTick)
+        m_scheduler.OnIdleDrop(m_clock.Now() - m_lastSendTick);
+    m_connected = false;
+    m_pendingIdleMs = 0;
+    CancelTimers();
+}
+
+void ConnectionLifecycle::OnPong() {
+    // The gap before the report this answers did not kill the connection
+    if (m_pendingIdleMs) {
+        m_scheduler.OnIdleSurvived(m_pendingIdleMs);
+        m_pendingIdleMs = 0;
+    }
+    // Reset heartbeat, schedule the next report
+    m_connected = true;
+    m_clock.Cancel(Timer::Probe);
+    m_networkEventTick = 0; // Old path survived the network change
+    ArmHeartbeatTimers();
+}
+
+void ConnectionLifecycle::OnTimer(Timer timer) {
+    switch (timer) {
+    case Timer::Heartbeat:
+        // No pong within the report interval plus grace: the socket is dead even if
+        // WinHTTP has not noticed yet, so rebuild it rather than wait for a receive error
+        LOG_WARN("Heartbeat timeout: no pong within {} ms", m_scheduler.HeartbeatTimeoutMs());
+        m_connected = false;
+        m_pendingIdleMs = 0;
+        CancelTimers();
+        m_transport.Reconnect();
+        break;
+    case Timer::Probe:
+        // No pong on the old path after a network change: rebuild on the new one
+        LOG_INFO("Probe after network change timed out, reconnecting");
+        m_transport.Reconnect();
+        break;
+    case Timer::Report: {
+        // A gap longer than the pong deadline means the timers were held up (sleep, a late
+        // coalesced timer), not that the connection stayed quiet that long
+        ULONGLONG idle = m_clock.Now() - m_lastSendTick;
+        m_pendingIdleMs = m_connected && !m_networkEventTick && idle <= m_scheduler.HeartbeatTimeoutMs()
+            ? idle : 0;
+        SendReport();
+        m_clock.Arm(Timer::Report, m_scheduler.ReportIntervalMs(), m_scheduler.ToleranceMs());
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void ConnectionLifecycle::FlushReport() {
+    SendReport();
+    m_clock.Arm(Timer::Report, m_scheduler.ReportIntervalMs(), m_scheduler.ToleranceMs());
+}
+
+void ConnectionLifecycle::OnNetworkEvent() {
+    if (!m_networkEventTick) m_networkEventTick = m_clock.Now();
+    m_pendingIdleMs = 0;
+}
+
+void ConnectionLifecycle::OnNetworkSettled() {
+    if (m_connected) {
+        // The old path may still work (e.g. an unrelated adapter changed): probe it with a
+        // report and only reconnect if the pong does not come back quickly
+        LOG_INFO("Network changed while connected, probing");
+        SendReport();
+        m_clock.Arm(Timer::Probe, kProbeTimeoutMs, 0);
+    } else {
+        LOG_INFO("Network changed while disconnected, reconnecting now");
+        m_transport.Reconnect();
+    }
+}
+
+void ConnectionLifecycle::OnResume() {
+    // Any connection from before the sleep is dead; don't wait for the heartbeat to notice
+    LOG_INFO("Resumed from sleep, reconnecting");
+    m_networkEventTick = m_clock.Now();
+    m_pendingIdleMs = 0;
+    m_clock.Cancel(Timer::Probe);
+    m_transport.Reconnect();
+}
+
+void ConnectionLifecycle::OnLocalStop() {
+    m_localStop = true;
+    CancelTimers();
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <Windows.h>
+#include "HeartbeatScheduler.h"
+
+// Connection state machine of the tray agent: reports, pong deadline, probing
+// after network changes and reconnect decisions.
+//
+// Time and I/O are injected: the app drives it from window timers and the
+// WebSocket client, while the simulator drives it from a virtual clock and a
+// modelled transport. All calls come from one thread.
+class ConnectionLifecycle {
+public:
+    enum class Timer { Report, Heartbeat, Probe, Count };
+
+    class Clock {
+    public:
+        virtual ~Clock() = default;
+        virtual ULONGLONG Now() = 0;
+        // One-shot; re-arming an armed timer replaces its deadline
+        virtual void Arm(Timer timer, ULONGLONG dueMs, ULONG toleranceMs) = 0;
+        virtual void Cancel(Timer timer) = 0;
+    };
+
+    class Transport {
+    public:
+        virtual ~Transport() = default;
+        virtual void SendReport() = 0;
+        // Drop the current connection and connect again without backoff
+        virtual void Reconnect() = 0;
+    };
+
+    static constexpr ULONGLONG kProbeTimeoutMs = 3000;
+
+    ConnectionLifecycle(Clock& clock, Transport& transport, HeartbeatScheduler& scheduler)
+        : m_clock(clock), m_transport(transport), m_scheduler(scheduler) {}
+
+    // Transport events
+    void OnConnected();
+    void OnDisconnected();
+    void OnPong();
+
+    // Environment events
+    void OnTimer(Timer timer);
+    void OnNetworkEvent();   // Raw notification; marks the start of a change
+    void OnNetworkSettled(); // After debouncing
+    void OnResume();
+    void OnLocalStop();      // The app itself is tearing the connection down
+
+    // Send a report now instead of at the next report timer (control channel)
+    void FlushReport();
+
+    // True while pongs arrive in time, i.e. commands can reach us
+    bool IsConnected() const { return m_connected; }
+    ULONGLONG LastSendTick() const { return m_lastSendTick; }
+
+private:
+    void SendReport();
+    void ArmHeartbeatTimers();
+    void CancelTimers();
+
+    Clock& m_clock;
+    Transport& m_transport;
+    HeartbeatScheduler& m_scheduler;
+
+    bool m_connected = false;
+    bool m_localStop = false;
+    ULONGLONG m_lastSendTick = 0;
+    ULONGLONG m_networkEventTick = 0; // Start of the current network change / resume, 0 if none
+    // Quiet gap before the last timer report, counted as survived once its pong arrives;
+    // 0 if there is none or a network change, resume or drop happened since
+    ULONGLONG m_pendingIdleMs = 0;
+};
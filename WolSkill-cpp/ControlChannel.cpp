@@ -0,0 +1,212 @@
+#include "ControlChannel.h"
+#include "Log.h"
+#include <sddl.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#pragma comment(lib, "advapi32.lib")
+
+static constexpr DWORD PIPE_BUFFER_SIZE = 4096;
+static constexpr DWORD MAX_REQUEST_SIZE = 256;
+// The window can be inside a modal loop; it still pumps messages, so this only guards a hang
+static constexpr DWORD REQUEST_TIMEOUT_MS = 5000;
+
+// Shared by the pipe thread and the window; whichever releases it last frees it,
+// so a request still queued when the server stops is never answered into freed memory
+struct PendingRequest {
+    std::string command;
+    std::string response;
+    HANDLE done = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    ~PendingRequest() { if (done) CloseHandle(done); }
+};
+using RequestRef = std::shared_ptr<PendingRequest>;
+
+static HWND g_target = nullptr;
+static UINT g_msg = 0;
+static HANDLE g_pipe = INVALID_HANDLE_VALUE;
+static HANDLE g_stopEvent = nullptr;
+static std::thread g_thread;
+
+// Full access for the current user and SYSTEM only
+static bool BuildSecurityAttributes(SECURITY_ATTRIBUTES& sa) {
+    HANDLE hToken = nullptr;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &hToken)) return false;
+
+    bool ok = false;
+    DWORD size = 0;
+    GetTokenInformation(hToken, TokenUser, nullptr, 0, &size);
+    std::vector<BYTE> buffer(size);
+    LPWSTR sid = nullptr;
+    if (size && GetTokenInformation(hToken, TokenUser, buffer.data(), size, &size) &&
+        ConvertSidToStringSidW(reinterpret_cast<TOKEN_USER*>(buffer.data())->User.Sid, &sid)) {
+        std::wstring sddl = L"D:P(A;;GA;;;SY)(A;;GA;;;" + std::wstring(sid) + L")";
+        LocalFree(sid);
+        sa.nLength = sizeof(sa);
+        sa.bInheritHandle = FALSE;
+        ok = ConvertStringSecurityDescriptorToSecurityDescriptorW(
+            sddl.c_str(), SDDL_REVISION_1, &sa.lpSecurityDescriptor, nullptr) != FALSE;
+    }
+    CloseHandle(hToken);
+    return ok;
+}
+
+// Waits for an overlapped operation on the pipe; cancels it if the server is stopping
+static bool WaitIo(OVERLAPPED& ov, DWORD& bytes) {
+    HANDLE handles[] = { ov.hEvent, g_stopEvent };
+    if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0) {
+        CancelIoEx(g_pipe, &ov);
+        GetOverlappedResult(g_pipe, &ov, &bytes, TRUE);
+        return false;
+    }
+    return GetOverlappedResult(g_pipe, &ov, &bytes, FALSE) != FALSE;
+}
+
+static bool ConnectClient(OVERLAPPED& ov) {
+    if (ConnectNamedPipe(g_pipe, &ov)) return true;
+    switch (GetLastError()) {
+    case ERROR_PIPE_CONNECTED:
+        return true;
+    case ERROR_IO_PENDING: {
+        DWORD bytes = 0;
+        return WaitIo(ov, bytes);
+    }
+    default:
+        return false;
+    }
+}
+
+// Hands the command to the window and waits for its answer
+static std::string Dispatch(std::string command) {
+    auto request = std::make_shared<PendingRequest>();
+    request->command = std::move(command);
+
+    auto* ref = new RequestRef(request);
+    if (!request->done || !PostMessageW(g_target, g_msg, 0, reinterpret_cast<LPARAM>(ref))) {
+        delete ref;
+        return "{\"error\":\"unavailable\"}";
+    }
+
+    HANDLE handles[] = { request->done, g_stopEvent };
+    DWORD wait = WaitForMultipleObjects(2, handles, FALSE, REQUEST_TIMEOUT_MS);
+    if (wait == WAIT_OBJECT_0) return std::move(request->response);
+    if (wait == WAIT_TIMEOUT) {
+        LOG_WARN("Control request not answered within {} ms", REQUEST_TIMEOUT_MS);
+        return "{\"error\":\"timeout\"}";
+    }
+    return "{\"error\":\"stopping\"}";
+}
+
+static void ServeClient(OVERLAPPED& ov) {
+    char buffer[MAX_REQUEST_SIZE];
+    for (;;) {
+        DWORD bytes = 0;
+        ResetEvent(ov.hEvent);
+        if (!ReadFile(g_pipe, buffer, sizeof(buffer), &bytes, &ov) && GetLastError() != ERROR_IO_PENDING)
+            return;
+        if (!WaitIo(ov, bytes)) return; // Disconnected, oversized message or stopping
+
+        std::string response = Dispatch(std::string(buffer, bytes));
+
+        ResetEvent(ov.hEvent);
+        if (!WriteFile(g_pipe, response.data(), static_cast<DWORD>(response.size()), &bytes, &ov) &&
+            GetLastError() != ERROR_IO_PENDING)
+            return;
+        if (!WaitIo(ov, bytes)) return;
+    }
+}
+
+static void ServerThread() {
+    OVERLAPPED ov{};
+    ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!ov.hEvent) return;
+
+    // One pipe instance serves clients one after another; others wait in WaitNamedPipe
+    while (WaitForSingleObject(g_stopEvent, 0) == WAIT_TIMEOUT) {
+        ResetEvent(ov.hEvent);
+        if (ConnectClient(ov)) {
+            LOG_DEBUG("Control client connected");
+            ServeClient(ov);
+        }
+        DisconnectNamedPipe(g_pipe);
+    }
+    CloseHandle(ov.hEvent);
+}
+
+bool ControlChannel::StartServer(HWND hWnd, UINT msg) {
+    g_target = hWnd;
+    g_msg = msg;
+
+    SECURITY_ATTRIBUTES sa{};
+    if (!BuildSecurityAttributes(sa)) {
+        LOG_WARN("Control pipe: cannot build security descriptor ({})", GetLastError());
+        return false;
+    }
+    // FILE_FLAG_FIRST_PIPE_INSTANCE fails if another process already owns the name
+    g_pipe = CreateNamedPipeW(PIPE_NAME,
+        PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+        PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+        1, PIPE_BUFFER_SIZE, MAX_REQUEST_SIZE, 0, &sa);
+    LocalFree(sa.lpSecurityDescriptor);
+    if (g_pipe == INVALID_HANDLE_VALUE) {
+        LOG_WARN("Control pipe: CreateNamedPipe failed ({})", GetLastError());
+        return false;
+    }
+
+    g_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    g_thread = std::thread(ServerThread);
+    LOG_INFO("Control pipe listening");
+    return true;
+}
+
+void ControlChannel::StopServer() {
+    if (g_stopEvent) SetEvent(g_stopEvent);
+    if (g_thread.joinable()) g_thread.join();
+    if (g_pipe != INVALID_HANDLE_VALUE) { CloseHandle(g_pipe); g_pipe = INVALID_HANDLE_VALUE; }
+    if (g_stopEvent) { CloseHandle(g_stopEvent); g_stopEvent = nullptr; }
+    g_target = nullptr;
+}
+
+const std::string& ControlChannel::Command(LPARAM request) {
+    return (*reinterpret_cast<RequestRef*>(request))->command;
+}
+
+void ControlChannel::Respond(LPARAM request, std::string response) {
+    std::unique_ptr<RequestRef> ref(reinterpret_cast<RequestRef*>(request));
+    (*ref)->response = std::move(response);
+    SetEvent((*ref)->done);
+}
+
+// ---------- Client ----------
+ControlChannel::Client::~Client() {
+    if (m_pipe != INVALID_HANDLE_VALUE) CloseHandle(m_pipe);
+}
+
+bool ControlChannel::Client::Open(DWORD timeoutMs) {
+    ULONGLONG deadline = GetTickCount64() + timeoutMs;
+    for (;;) {
+        m_pipe = CreateFileW(PIPE_NAME, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (m_pipe != INVALID_HANDLE_VALUE) break;
+        // Busy: the single instance is serving another client
+        ULONGLONG now = GetTickCount64();
+        if (GetLastError() != ERROR_PIPE_BUSY || now >= deadline) return false;
+        WaitNamedPipeW(PIPE_NAME, static_cast<DWORD>(deadline - now));
+    }
+    DWORD mode = PIPE_READMODE_MESSAGE;
+    return SetNamedPipeHandleState(m_pipe, &mode, nullptr, nullptr) != FALSE;
+}
+
+bool ControlChannel::Client::Transact(const std::string& request, std::string& response) {
+    char buffer[PIPE_BUFFER_SIZE];
+    DWORD bytes = 0;
+    response.clear();
+    BOOL ok = TransactNamedPipe(m_pipe, const_cast<char*>(request.data()), static_cast<DWORD>(request.size()),
+        buffer, sizeof(buffer), &bytes, nullptr);
+    response.append(buffer, bytes);
+    // Responses larger than the buffer (status with many adapters) arrive in pieces
+    while (!ok && GetLastError() == ERROR_MORE_DATA) {
+        ok = ReadFile(m_pipe, buffer, sizeof(buffer), &bytes, nullptr);
+        response.append(buffer, bytes);
+    }
+    return ok != FALSE;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <Windows.h>
+#include <string>
+
+// Local control and status endpoint on a named pipe, for scripts and
+// monitoring (`WolSkill-cpp.exe --ctl <command>`).
+//
+// Each request is one pipe message holding a command ("status", "ping",
+// "reconnect", "report", "reload"); each response is one JSON message. The
+// pipe thread does no work itself: it posts the request to the tray window
+// and waits, so commands run on the thread that owns the connection
+// lifecycle and never block WebSocket I/O. The pipe is restricted to the
+// current user and local clients.
+namespace ControlChannel {
+    static constexpr const wchar_t* PIPE_NAME = L"\\\\.\\pipe\\WolSkillControl";
+
+    // Server side: `msg` is posted to `hWnd` with the request in LPARAM
+    bool StartServer(HWND hWnd, UINT msg);
+    void StopServer();
+
+    // Window side: read the command of a posted request, then answer it exactly once
+    const std::string& Command(LPARAM request);
+    void Respond(LPARAM request, std::string response);
+
+    // Client side, used by the command line mode
+    class Client {
+    public:
+        Client() = default;
+        ~Client();
+        Client(const Client&) = delete;
+        Client& operator=(const Client&) = delete;
+
+        bool Open(DWORD timeoutMs);
+        bool Transact(const std::string& request, std::string& response);
+
+    private:
+        HANDLE m_pipe = INVALID_HANDLE_VALUE;
+    };
+}
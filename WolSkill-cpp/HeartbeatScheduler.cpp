@@ -0,0 +1,95 @@
+#include "HeartbeatScheduler.h"
+#include "Log.h"
+
+// Base report interval per mode, before the learned idle timeout cap
+static constexpr ULONGLONG BASE_INTERVAL_MS[] = {
+    30 * 1000,   // Normal (matches the original fixed 30 s report)
+    90 * 1000,   // Battery
+    120 * 1000,  // DisplayOff
+    300 * 1000,  // BatteryDisplayOff
+};
+
+// Idle drops shorter than this are treated as network failures, not idle timeouts
+static constexpr ULONGLONG MIN_IDLE_SAMPLE_MS = 20 * 1000;
+
+void HeartbeatScheduler::SetOnBattery(bool onBattery, ULONGLONG now) {
+    m_onBattery = onBattery;
+    SwitchMode(GetMode(), now);
+}
+
+void HeartbeatScheduler::SetDisplayOn(bool displayOn, ULONGLONG now) {
+    m_displayOn = displayOn;
+    SwitchMode(GetMode(), now);
+}
+
+HeartbeatScheduler::Mode HeartbeatScheduler::GetMode() const {
+    if (m_onBattery && !m_displayOn) return Mode::BatteryDisplayOff;
+    if (m_onBattery) return Mode::Battery;
+    if (!m_displayOn) return Mode::DisplayOff;
+    return Mode::Normal;
+}
+
+void HeartbeatScheduler::SwitchMode(Mode next, ULONGLONG now) {
+    if (next == m_mode) return;
+    m_stats[static_cast<int>(m_mode)].activeMs += now - m_modeSince;
+    LOG_INFO("Heartbeat mode {} -> {} ({} wakeups/h in previous mode)",
+        ModeName(m_mode), ModeName(next), WakeupsPerHour(m_mode, now));
+    m_mode = next;
+    m_modeSince = now;
+}
+
+void HeartbeatScheduler::OnIdleSurvived(ULONGLONG idleMs) {
+    if (idleMs > kMaxIdleTimeoutMs) idleMs = kMaxIdleTimeoutMs;
+    if (idleMs > m_maxSurvivedMs) m_maxSurvivedMs = idleMs;
+    // An earlier drop was shorter than a gap we have now survived: it was noise
+    if (idleMs >= m_idleTimeoutMs && m_idleTimeoutMs < kMaxIdleTimeoutMs) {
+        m_idleTimeoutMs = idleMs + kMinIntervalMs;
+        if (m_idleTimeoutMs > kMaxIdleTimeoutMs) m_idleTimeoutMs = kMaxIdleTimeoutMs;
+        LOG_DEBUG("Idle timeout estimate raised to {} ms", m_idleTimeoutMs);
+    }
+}
+
+void HeartbeatScheduler::OnIdleDrop(ULONGLONG idleMs) {
+    if (idleMs < MIN_IDLE_SAMPLE_MS || idleMs >= m_idleTimeoutMs) return;
+
+    // A gap at least this long was survived before, so this was a random close, not a timeout
+    if (idleMs <= m_maxSurvivedMs) return;
+    m_idleTimeoutMs = idleMs;
+    LOG_INFO("Server dropped connection after {} ms idle; report interval now {} ms",
+        idleMs, ReportIntervalMs());
+}
+
+ULONGLONG HeartbeatScheduler::ReportIntervalMs() const {
+    ULONGLONG interval = BASE_INTERVAL_MS[static_cast<int>(m_mode)];
+    ULONGLONG cap = m_idleTimeoutMs / 2;
+    if (interval > cap) interval = cap;
+    if (interval < kMinIntervalMs) interval = kMinIntervalMs;
+    return interval;
+}
+
+ULONGLONG HeartbeatScheduler::HeartbeatTimeoutMs() const {
+    return ReportIntervalMs() + ToleranceMs() + kHeartbeatGraceMs;
+}
+
+ULONG HeartbeatScheduler::ToleranceMs() const {
+    // 10% slack while interactive, 25% in power-saving modes
+    ULONGLONG interval = ReportIntervalMs();
+    return static_cast<ULONG>(m_mode == Mode::Normal ? interval / 10 : interval / 4);
+}
+
+double HeartbeatScheduler::WakeupsPerHour(Mode mode, ULONGLONG now) const {
+    const ModeStats& s = m_stats[static_cast<int>(mode)];
+    ULONGLONG activeMs = s.activeMs + (mode == m_mode ? now - m_modeSince : 0);
+    if (activeMs == 0) return 0.0;
+    return static_cast<double>(s.wakeups) * 3600000.0 / static_cast<double>(activeMs);
+}
+
+const char* HeartbeatScheduler::ModeName(Mode mode) {
+    switch (mode) {
+    case Mode::Normal: return "normal";
+    case Mode::Battery: return "battery";
+    case Mode::DisplayOff: return "display-off";
+    case Mode::BatteryDisplayOff: return "battery+display-off";
+    default: return "?";
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <Windows.h>
+#include <cstdint>
+
+// Chooses the report interval and heartbeat timeout for the tray window timers.
+//
+// The interval is stretched on battery or while the display is off, and is
+// capped at half of the gateway idle timeout learned from connections that the
+// server dropped while we were quiet. ToleranceMs() is the slack the timers
+// are armed with, so the OS can batch the wakeups with other work.
+class HeartbeatScheduler {
+public:
+    enum class Mode { Normal, Battery, DisplayOff, BatteryDisplayOff, Count };
+
+    static constexpr ULONGLONG kDefaultIdleTimeoutMs = 10 * 60 * 1000; // API Gateway idle timeout
+    static constexpr ULONGLONG kMinIntervalMs = 15 * 1000;
+    static constexpr ULONGLONG kHeartbeatGraceMs = 10 * 1000;          // Time allowed for the pong
+    // Upper bound of the learned idle timeout; beyond twice the longest interval it caps nothing
+    static constexpr ULONGLONG kMaxIdleTimeoutMs = 30 * 60 * 1000;
+
+    // `now` is read from the same clock as every later call
+    explicit HeartbeatScheduler(ULONGLONG now) : m_modeSince(now) {}
+
+    void SetOnBattery(bool onBattery, ULONGLONG now);
+    void SetDisplayOn(bool displayOn, ULONGLONG now);
+    Mode GetMode() const;
+
+    // A connection survived this long without outbound traffic, confirmed by a pong
+    void OnIdleSurvived(ULONGLONG idleMs);
+    // The server closed a connection after this long without outbound traffic
+    void OnIdleDrop(ULONGLONG idleMs);
+    ULONGLONG LearnedIdleTimeoutMs() const { return m_idleTimeoutMs; }
+
+    ULONGLONG ReportIntervalMs() const;
+    ULONGLONG HeartbeatTimeoutMs() const;
+    ULONG ToleranceMs() const;
+
+    // Count one timer-driven wakeup against the current mode
+    void OnWakeup() { ++m_stats[static_cast<int>(m_mode)].wakeups; }
+
+    // Wakeups per hour spent in the given mode (0 if the mode has not been active)
+    double WakeupsPerHour(Mode mode, ULONGLONG now) const;
+    static const char* ModeName(Mode mode);
+
+private:
+    struct ModeStats {
+        ULONGLONG activeMs = 0;
+        uint64_t wakeups = 0;
+    };
+
+    void SwitchMode(Mode next, ULONGLONG now);
+
+    bool m_onBattery = false;
+    bool m_displayOn = true;
+    Mode m_mode = Mode::Normal;
+    ULONGLONG m_modeSince;
+    ULONGLONG m_idleTimeoutMs = kDefaultIdleTimeoutMs;
+    ULONGLONG m_maxSurvivedMs = 0; // Longest quiet gap a connection has survived
+    ModeStats m_stats[static_cast<int>(Mode::Count)];
+};
@@ -0,0 +1,163 @@
+#pragma once
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Minimal JSON writer for outbound messages.
+//
+// Appends to a caller-owned std::string; callers keep the buffer and clear()
+// it before each message, so once it has grown to the largest message no
+// further heap allocation happens. Keys known at compile time are escaped
+// and quoted during compilation (Key<"mac">()). Runtime strings get full
+// RFC 8259 escaping, and numbers go through std::to_chars (no locale, no
+// streams). Commas are inserted automatically.
+namespace Json {
+    inline constexpr char kHexDigits[] = "0123456789abcdef";
+
+    // Writes `width` lowercase hex digits of `value` to `out`
+    constexpr void HexDigits(char* out, uint64_t value, int width) {
+        for (int i = width - 1; i >= 0; --i) {
+            out[i] = kHexDigits[value & 0xF];
+            value >>= 4;
+        }
+    }
+
+    // Escape sequence for `c` per RFC 8259 section 7; returns its length, or 0 if `c` is copied as is
+    constexpr size_t Escape(unsigned char c, char (&seq)[6]) {
+        char shortForm = 0;
+        switch (c) {
+        case '"': shortForm = '"'; break;
+        case '\\': shortForm = '\\'; break;
+        case '\b': shortForm = 'b'; break;
+        case '\f': shortForm = 'f'; break;
+        case '\n': shortForm = 'n'; break;
+        case '\r': shortForm = 'r'; break;
+        case '\t': shortForm = 't'; break;
+        default:
+            if (c >= 0x20) return 0;
+            seq[0] = '\\'; seq[1] = 'u'; seq[2] = '0'; seq[3] = '0';
+            HexDigits(seq + 4, c, 2);
+            return 6;
+        }
+        seq[0] = '\\';
+        seq[1] = shortForm;
+        return 2;
+    }
+
+    // String literal usable as a template argument
+    template <size_t N>
+    struct FixedString {
+        char chars[N]{};
+        constexpr FixedString(const char (&s)[N]) {
+            for (size_t i = 0; i < N; ++i) chars[i] = s[i];
+        }
+        static constexpr size_t length = N - 1;
+    };
+
+    // "key": with the key escaped, built at compile time
+    template <FixedString Key>
+    struct QuotedKey {
+        static constexpr size_t length = [] {
+            size_t n = 3; // Two quotes and the colon
+            char seq[6]{};
+            for (size_t i = 0; i < Key.length; ++i) {
+                size_t e = Escape(static_cast<unsigned char>(Key.chars[i]), seq);
+                n += e ? e : 1;
+            }
+            return n;
+        }();
+
+        static constexpr std::array<char, length> text = [] {
+            std::array<char, length> t{};
+            size_t n = 0;
+            t[n++] = '"';
+            for (size_t i = 0; i < Key.length; ++i) {
+                char seq[6]{};
+                size_t e = Escape(static_cast<unsigned char>(Key.chars[i]), seq);
+                if (e == 0) t[n++] = Key.chars[i];
+                for (size_t j = 0; j < e; ++j) t[n++] = seq[j];
+            }
+            t[n++] = '"';
+            t[n++] = ':';
+            return t;
+        }();
+    };
+
+    class Writer {
+    public:
+        explicit Writer(std::string& out) : m_out(out), m_start(out.size()) {}
+
+        void BeginObject() { Separate(); m_out += '{'; }
+        void EndObject() { m_out += '}'; }
+        void BeginArray() { Separate(); m_out += '['; }
+        void EndArray() { m_out += ']'; }
+
+        template <FixedString K>
+        void Key() {
+            Separate();
+            m_out.append(QuotedKey<K>::text.data(), QuotedKey<K>::length);
+        }
+
+        // Key only known at run time (adapter names)
+        void Key(std::string_view key) {
+            Separate();
+            Quote(key);
+            m_out += ':';
+        }
+
+        void String(std::string_view value) { Separate(); Quote(value); }
+        void Bool(bool value) { Separate(); m_out += value ? "true" : "false"; }
+        void Null() { Separate(); m_out += "null"; }
+
+        template <std::integral T>
+        void Number(T value) {
+            char buf[24];
+            auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+            Separate();
+            m_out.append(buf, end);
+        }
+
+        // Already serialized JSON value
+        void Raw(std::string_view json) { Separate(); m_out += json; }
+
+        template <FixedString K>
+        void Field(std::string_view value) { Key<K>(); String(value); }
+
+        template <FixedString K, std::integral T>
+        void Field(T value) {
+            Key<K>();
+            if constexpr (std::same_as<T, bool>) Bool(value);
+            else Number(value);
+        }
+
+    private:
+        // Comma before any value or key that does not open a container or follow a key
+        void Separate() {
+            if (m_out.size() == m_start) return;
+            char last = m_out.back();
+            if (last != '{' && last != '[' && last != ':') m_out += ',';
+        }
+
+        void Quote(std::string_view s) {
+            m_out += '"';
+            size_t run = 0;
+            char seq[6];
+            for (size_t i = 0; i < s.size(); ++i) {
+                size_t e = Escape(static_cast<unsigned char>(s[i]), seq);
+                if (e == 0) continue;
+                m_out.append(s.data() + run, i - run);
+                m_out.append(seq, e);
+                run = i + 1;
+            }
+            m_out.append(s.data() + run, s.size() - run);
+            m_out += '"';
+        }
+
+        std::string& m_out;
+        size_t m_start;
+    };
+}
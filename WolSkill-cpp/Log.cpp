@@ -0,0 +1,412 @@
+#include "Log.h"
+#include <ShlObj.h>
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#pragma comment(lib, "shell32.lib")
+
+namespace {
+
+constexpr uint32_t kRingCapacity = 256;           // Records per thread (32 KiB), power of two
+constexpr uint64_t kMaxFileBytes = 1024 * 1024;   // Rotate after 1 MiB
+constexpr int kMaxFiles = 3;                      // wolskill.log, .1.log, .2.log
+constexpr DWORD kFlushIntervalMs = 250;
+
+static_assert((kRingCapacity & (kRingCapacity - 1)) == 0, "ring capacity must be a power of two");
+
+// Single-producer/single-consumer ring. The owning thread advances head,
+// the flush thread advances tail.
+struct Ring {
+    alignas(64) std::atomic<uint32_t> head{ 0 };
+    alignas(64) std::atomic<uint32_t> tail{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<bool> retired{ false };
+    DWORD threadId = 0;
+    Log::Record slots[kRingCapacity];
+};
+
+// Marks the ring retired when its thread exits; the flush thread frees it once drained
+struct RingOwner {
+    Ring* ring = nullptr;
+    ~RingOwner() { if (ring) ring->retired.store(true, std::memory_order_release); }
+};
+
+std::mutex g_ringsMutex;
+std::vector<Ring*> g_rings;
+
+thread_local RingOwner t_owner;
+
+std::thread g_flushThread;
+std::mutex g_wakeMutex;
+std::condition_variable g_wakeCv;
+bool g_wakeRequested = false;
+bool g_stopRequested = false;
+// Flush() tickets: requested by callers, completed by the flush thread (under g_wakeMutex)
+uint64_t g_flushRequested = 0;
+uint64_t g_flushCompleted = 0;
+std::condition_variable g_flushedCv;
+std::atomic<bool> g_running{ false };
+
+HANDLE g_file = INVALID_HANDLE_VALUE;
+uint64_t g_fileBytes = 0;
+std::wstring g_dir;
+
+// Mapping from QPC ticks to wall-clock FILETIME, captured at Init
+LARGE_INTEGER g_qpcFreq{};
+LARGE_INTEGER g_qpcBase{};
+ULARGE_INTEGER g_fileTimeBase{};
+
+Ring* AcquireRing() {
+    if (t_owner.ring) return t_owner.ring;
+    auto* ring = new Ring();
+    ring->threadId = GetCurrentThreadId();
+    {
+        std::lock_guard lock(g_ringsMutex);
+        g_rings.push_back(ring);
+    }
+    t_owner.ring = ring;
+    return ring;
+}
+
+const char* LevelName(Log::Level level) {
+    switch (level) {
+    case Log::Level::Trace: return "TRACE";
+    case Log::Level::Debug: return "DEBUG";
+    case Log::Level::Info:  return "INFO ";
+    case Log::Level::Warn:  return "WARN ";
+    case Log::Level::Error: return "ERROR";
+    default:                return "?    ";
+    }
+}
+
+void AppendArg(std::string& out, const Log::Record& rec, const Log::Arg& a) {
+    char buf[32];
+    std::to_chars_result r{};
+    switch (a.type) {
+    case Log::Arg::Type::Int:
+        r = std::to_chars(buf, buf + sizeof(buf), a.i);
+        break;
+    case Log::Arg::Type::UInt:
+        r = std::to_chars(buf, buf + sizeof(buf), a.u);
+        break;
+    case Log::Arg::Type::Hex:
+        out += "0x";
+        r = std::to_chars(buf, buf + sizeof(buf), a.u, 16);
+        break;
+    case Log::Arg::Type::Double:
+        r = std::to_chars(buf, buf + sizeof(buf), a.d, std::chars_format::fixed, 3);
+        break;
+    case Log::Arg::Type::Literal:
+        out += a.s ? a.s : "(null)";
+        return;
+    case Log::Arg::Type::Text:
+        if (a.u < Log::kTextBytes) out.append(rec.text + a.u, strnlen(rec.text + a.u, Log::kTextBytes - a.u));
+        return;
+    default:
+        return;
+    }
+    out.append(buf, r.ptr);
+}
+
+void AppendTimestamp(std::string& out, int64_t ticks) {
+    // 100 ns units since the Init capture
+    int64_t delta = ticks - g_qpcBase.QuadPart;
+    int64_t hns = (delta / g_qpcFreq.QuadPart) * 10000000 +
+        (delta % g_qpcFreq.QuadPart) * 10000000 / g_qpcFreq.QuadPart;
+
+    ULARGE_INTEGER ft;
+    ft.QuadPart = g_fileTimeBase.QuadPart + hns;
+    FILETIME utc{ ft.LowPart, ft.HighPart }, local;
+    SYSTEMTIME st;
+    FileTimeToLocalFileTime(&utc, &local);
+    FileTimeToSystemTime(&local, &st);
+
+    char buf[32];
+    int n = wsprintfA(buf, "%04u-%02u-%02u %02u:%02u:%02u.%03u ",
+        st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
+    out.append(buf, n);
+}
+
+void FormatRecord(std::string& out, const Log::Record& r) {
+    AppendTimestamp(out, r.ticks);
+    out += '[';
+    out += LevelName(r.level);
+    out += "] [";
+    char tid[16];
+    out.append(tid, std::to_chars(tid, tid + sizeof(tid), r.threadId).ptr);
+    out += "] ";
+
+    // "{}" placeholders are substituted in order
+    int next = 0;
+    for (const char* p = r.fmt; *p; ++p) {
+        if (p[0] == '{' && p[1] == '}' && next < r.argc) {
+            AppendArg(out, r, r.args[next++]);
+            ++p;
+        } else {
+            out += *p;
+        }
+    }
+    out += "\r\n";
+}
+
+std::wstring LogPath(int index) {
+    if (index == 0) return g_dir + L"\\wolskill.log";
+    return g_dir + L"\\wolskill." + std::to_wstring(index) + L".log";
+}
+
+void OpenLogFile() {
+    g_file = CreateFileW(LogPath(0).c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_DELETE,
+        nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size{};
+    if (g_file != INVALID_HANDLE_VALUE && GetFileSizeEx(g_file, &size))
+        g_fileBytes = static_cast<uint64_t>(size.QuadPart);
+    else
+        g_fileBytes = 0;
+}
+
+void RotateLogFile() {
+    if (g_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(g_file);
+        g_file = INVALID_HANDLE_VALUE;
+    }
+    DeleteFileW(LogPath(kMaxFiles - 1).c_str());
+    for (int i = kMaxFiles - 2; i >= 0; --i)
+        MoveFileExW(LogPath(i).c_str(), LogPath(i + 1).c_str(), MOVEFILE_REPLACE_EXISTING);
+    OpenLogFile();
+}
+
+void WriteOut(const std::string& text) {
+    if (text.empty()) return;
+    if (g_fileBytes + text.size() > kMaxFileBytes)
+        RotateLogFile();
+    if (g_file == INVALID_HANDLE_VALUE) return;
+    DWORD written = 0;
+    WriteFile(g_file, text.data(), static_cast<DWORD>(text.size()), &written, nullptr);
+    g_fileBytes += written;
+}
+
+// Drain every ring into one timestamp-ordered batch and write it out
+void Drain(std::vector<Log::Record>& batch, std::string& text) {
+    batch.clear();
+    text.clear();
+    uint64_t dropped = 0;
+
+    std::vector<Ring*> retired;
+    {
+        std::lock_guard lock(g_ringsMutex);
+        for (auto* ring : g_rings) {
+            // Read retired before head so a ring is only freed after its last record is seen
+            bool isRetired = ring->retired.load(std::memory_order_acquire);
+            uint32_t head = ring->head.load(std::memory_order_acquire);
+            uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+            for (; tail != head; ++tail)
+                batch.push_back(ring->slots[tail & (kRingCapacity - 1)]);
+            ring->tail.store(tail, std::memory_order_release);
+            dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+            if (isRetired) retired.push_back(ring);
+        }
+        for (auto* ring : retired) {
+            g_rings.erase(std::find(g_rings.begin(), g_rings.end(), ring));
+            delete ring;
+        }
+    }
+
+    std::stable_sort(batch.begin(), batch.end(),
+        [](const Log::Record& a, const Log::Record& b) { return a.ticks < b.ticks; });
+
+    for (auto& r : batch)
+        FormatRecord(text, r);
+
+    if (dropped) {
+        Log::Record note{};
+        QueryPerformanceCounter(reinterpret_cast<LARGE_INTEGER*>(&note.ticks));
+        note.fmt = "log: dropped {} records (ring full)";
+        note.threadId = GetCurrentThreadId();
+        note.level = Log::Level::Warn;
+        note.argc = 1;
+        note.args[0].type = Log::Arg::Type::UInt;
+        note.args[0].u = dropped;
+        FormatRecord(text, note);
+    }
+
+    WriteOut(text);
+}
+
+void FlushThread() {
+    std::vector<Log::Record> batch;
+    std::string text;
+    batch.reserve(kRingCapacity);
+    text.reserve(64 * 1024);
+
+    for (;;) {
+        bool stop;
+        uint64_t ticket;
+        {
+            std::unique_lock lock(g_wakeMutex);
+            g_wakeCv.wait_for(lock, std::chrono::milliseconds(kFlushIntervalMs),
+                [] { return g_wakeRequested || g_stopRequested; });
+            g_wakeRequested = false;
+            stop = g_stopRequested;
+            ticket = g_flushRequested;
+        }
+        Drain(batch, text);
+
+        // Records committed before a Flush() call were drained above
+        if (ticket != g_flushCompleted) {
+            if (g_file != INVALID_HANDLE_VALUE) FlushFileBuffers(g_file);
+            {
+                std::lock_guard lock(g_wakeMutex);
+                g_flushCompleted = ticket;
+            }
+            g_flushedCv.notify_all();
+        }
+        if (stop) break;
+    }
+}
+
+} // namespace
+
+void Log::Init(const wchar_t* dir) {
+    if (g_running) return;
+
+    QueryPerformanceFrequency(&g_qpcFreq);
+    QueryPerformanceCounter(&g_qpcBase);
+    FILETIME now;
+    GetSystemTimePreciseAsFileTime(&now);
+    g_fileTimeBase.LowPart = now.dwLowDateTime;
+    g_fileTimeBase.HighPart = now.dwHighDateTime;
+
+    PWSTR localAppData = nullptr;
+    if (dir) {
+        g_dir = dir;
+    } else if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData))) {
+        g_dir = std::wstring(localAppData) + L"\\WolSkill";
+        CoTaskMemFree(localAppData);
+    }
+    if (!g_dir.empty()) {
+        CreateDirectoryW(g_dir.c_str(), nullptr);
+        OpenLogFile();
+    }
+
+    g_stopRequested = false;
+    g_running = true;
+    g_flushThread = std::thread(FlushThread);
+}
+
+void Log::Shutdown() {
+    if (!g_running) return;
+    {
+        std::lock_guard lock(g_wakeMutex);
+        g_stopRequested = true;
+    }
+    g_wakeCv.notify_one();
+    if (g_flushThread.joinable())
+        g_flushThread.join();
+    g_running = false;
+
+    if (g_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(g_file);
+        g_file = INVALID_HANDLE_VALUE;
+    }
+}
+
+void Log::Flush(DWORD timeoutMs) {
+    if (!g_running) return;
+    std::unique_lock lock(g_wakeMutex);
+    uint64_t ticket = ++g_flushRequested;
+    g_wakeRequested = true;
+    g_wakeCv.notify_one();
+    g_flushedCv.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+        [ticket] { return g_flushCompleted >= ticket; });
+}
+
+void Log::SetLevel(Level level) {
+    Detail::g_level.store(level, std::memory_order_relaxed);
+}
+
+Log::Record* Log::Detail::Begin() {
+    if (!g_running.load(std::memory_order_relaxed)) return nullptr;
+    Ring* ring = AcquireRing();
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    uint32_t tail = ring->tail.load(std::memory_order_acquire);
+    if (head - tail >= kRingCapacity) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Record* r = &ring->slots[head & (kRingCapacity - 1)];
+    QueryPerformanceCounter(reinterpret_cast<LARGE_INTEGER*>(&r->ticks));
+    r->threadId = ring->threadId;
+    return r;
+}
+
+void Log::Detail::Commit(Level level) {
+    Ring* ring = t_owner.ring;
+    ring->head.store(ring->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+    // Warnings and errors are flushed promptly; everything else waits for the next tick
+    if (level >= Level::Warn) {
+        {
+            std::lock_guard lock(g_wakeMutex);
+            g_wakeRequested = true;
+        }
+        g_wakeCv.notify_one();
+    }
+}
+
+// ---------- Benchmark ----------
+int Log::RunBenchmark(size_t count) {
+    // Batches stay below the ring capacity and are flushed in between, so no record is dropped
+    const size_t kBatch = kRingCapacity / 2;
+    count = (count + kBatch - 1) / kBatch * kBatch;
+
+    wchar_t temp[MAX_PATH];
+    DWORD n = GetTempPathW(MAX_PATH, temp);
+    std::wstring dir = std::wstring(temp, n) + L"WolSkill-bench-log";
+    Init(dir.c_str());
+    Level saved = Detail::g_level.load();
+
+    LARGE_INTEGER freq, t0, t1;
+    QueryPerformanceFrequency(&freq);
+    auto ns = [&freq](const LARGE_INTEGER& from, const LARGE_INTEGER& to) {
+        return static_cast<double>(to.QuadPart - from.QuadPart) * 1e9 / static_cast<double>(freq.QuadPart);
+    };
+
+    // Filtered at run time: one relaxed load and a branch
+    SetLevel(Level::Info);
+    QueryPerformanceCounter(&t0);
+    for (size_t i = 0; i < count; ++i)
+        LOG_DEBUG("bench {} {} {}", i, 0.5, Log::Literal("literal"));
+    QueryPerformanceCounter(&t1);
+    double disabledNs = ns(t0, t1) / static_cast<double>(count);
+
+    // Enabled: timestamp and record into the ring; formatting and I/O are on the flush thread
+    SetLevel(Level::Trace);
+    double enabledNs = 0.0, flushNs = 0.0;
+    for (size_t done = 0; done < count; done += kBatch) {
+        QueryPerformanceCounter(&t0);
+        for (size_t i = 0; i < kBatch; ++i)
+            LOG_DEBUG("bench {} {} {}", done + i, 0.5, Log::Literal("literal"));
+        QueryPerformanceCounter(&t1);
+        enabledNs += ns(t0, t1);
+        Flush(5000);
+        QueryPerformanceCounter(&t0);
+        flushNs += ns(t1, t0);
+    }
+    enabledNs /= static_cast<double>(count);
+    flushNs /= static_cast<double>(count);
+
+    SetLevel(saved);
+    Shutdown();
+
+    std::printf("%zu records of 3 arguments\n", count);
+    std::printf("  disabled (runtime level)  %8.1f ns/call\n", disabledNs);
+    std::printf("  enabled (caller)          %8.1f ns/call\n", enabledNs);
+    std::printf("  flush thread (format+write, incl. wait) %8.1f ns/record\n", flushNs);
+    std::printf("Scratch log: %ls\\wolskill.log\n", dir.c_str());
+    return 0;
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include <Windows.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// Compile-time floor: LOG_* calls below this level compile to nothing.
+// 0 = Trace, 1 = Debug, 2 = Info, 3 = Warn, 4 = Error.
+#ifndef WOLSKILL_LOG_MIN_LEVEL
+#define WOLSKILL_LOG_MIN_LEVEL 0
+#endif
+
+// Asynchronous structured logger.
+//
+// The hot path writes a fixed-size binary record (format string pointer + up to
+// four scalar arguments) into a lock-free single-producer ring owned by the
+// calling thread. Strings are copied into the record (truncated to kTextBytes
+// in total), except those wrapped in Log::Literal, which are stored by
+// pointer. A background thread drains all rings, formats the records and
+// appends them to a rotating file under %LOCALAPPDATA%\WolSkill.
+namespace Log {
+    enum class Level : uint8_t { Trace = 0, Debug, Info, Warn, Error, Off };
+
+    static constexpr int kMaxArgs = 4;
+    static constexpr size_t kTextBytes = 40; // Copied strings of one record; keeps it at 128 bytes
+
+    struct Arg {
+        enum class Type : uint8_t { None, Int, UInt, Hex, Double, Literal, Text }; // Text: u = offset
+        Type type = Type::None;
+        union {
+            int64_t i;
+            uint64_t u;
+            double d;
+            const char* s;
+        };
+    };
+
+    // Wrapper that formats an unsigned value as 0x... (error codes, handles)
+    struct Hex { uint64_t value; };
+
+    // String stored by pointer instead of copied. The constructor only accepts a
+    // constant expression, i.e. an array with static storage such as a literal.
+    struct Literal {
+        const char* s;
+        template <size_t N>
+        consteval Literal(const char (&v)[N]) : s(v) {}
+    };
+
+    struct Record {
+        int64_t ticks;          // QueryPerformanceCounter value
+        const char* fmt;        // Format id: must be a string literal
+        DWORD threadId;
+        Level level;
+        uint8_t argc;
+        uint8_t textUsed;
+        Arg args[kMaxArgs];
+        char text[kTextBytes];
+    };
+
+    // `dir` defaults to %LOCALAPPDATA%\WolSkill
+    void Init(const wchar_t* dir = nullptr);
+    void Shutdown();
+    void SetLevel(Level level);
+    // Writes out everything logged so far and waits for it to reach the disk, at most
+    // `timeoutMs`; for records that must survive the process (shutdown, fatal errors)
+    void Flush(DWORD timeoutMs = 1000);
+
+    // Cost of disabled and enabled LOG_* calls on the calling thread, printed to stdout
+    // (`WolSkill-cpp.exe --bench-log [count]`). Writes to a scratch log under %TEMP%.
+    int RunBenchmark(size_t count);
+
+    namespace Detail {
+        inline std::atomic<Level> g_level{ Level::Info };
+
+        // Reserve a slot in the calling thread's ring, or nullptr if it is full
+        Record* Begin();
+        void Commit(Level level);
+
+        inline Arg MakeArg(Hex v) { Arg a; a.type = Arg::Type::Hex; a.u = v.value; return a; }
+        inline Arg MakeArg(double v) { Arg a; a.type = Arg::Type::Double; a.d = v; return a; }
+        inline Arg MakeArg(float v) { return MakeArg(static_cast<double>(v)); }
+        inline Arg MakeArg(bool v) { Arg a; a.type = Arg::Type::Literal; a.s = v ? "true" : "false"; return a; }
+        // The pointer is read later by the flush thread, so only Literal is kept by reference
+        inline Arg MakeArg(Literal v) { Arg a; a.type = Arg::Type::Literal; a.s = v.s; return a; }
+
+        template <typename T>
+        Arg MakeArg(T v) requires std::is_integral_v<T> || std::is_enum_v<T> {
+            Arg a;
+            if constexpr (std::is_enum_v<T>) {
+                a.type = Arg::Type::Int;
+                a.i = static_cast<int64_t>(v);
+            } else if constexpr (std::is_signed_v<T>) {
+                a.type = Arg::Type::Int;
+                a.i = static_cast<int64_t>(v);
+            } else {
+                a.type = Arg::Type::UInt;
+                a.u = static_cast<uint64_t>(v);
+            }
+            return a;
+        }
+
+        Arg MakeArg(const std::string&) = delete;
+        Arg MakeArg(const std::wstring&) = delete;
+
+        // A C string may be gone by the time the flush thread runs: copy it
+        inline Arg CopyText(Record& r, const char* v) {
+            Arg a;
+            size_t room = kTextBytes - r.textUsed;
+            if (room == 0) { a.type = Arg::Type::Literal; a.s = "..."; return a; }
+            size_t n = v ? strnlen(v, room - 1) : 0;
+            if (n) std::memcpy(r.text + r.textUsed, v, n);
+            r.text[r.textUsed + n] = '\0';
+            a.type = Arg::Type::Text;
+            a.u = r.textUsed;
+            r.textUsed = static_cast<uint8_t>(r.textUsed + n + 1);
+            return a;
+        }
+
+        // Pointers and char arrays are copied; a literal array cannot be told apart from a
+        // local buffer here
+        template <typename T>
+        void StoreArg(Record& r, int i, T&& v) {
+            using Decayed = std::decay_t<T>;
+            if constexpr (std::is_same_v<Decayed, const char*> || std::is_same_v<Decayed, char*>)
+                r.args[i] = CopyText(r, v);
+            else
+                r.args[i] = MakeArg(v);
+        }
+    }
+
+    inline bool IsEnabled(Level level) {
+        return level >= Detail::g_level.load(std::memory_order_relaxed);
+    }
+
+    template <typename... Args>
+    void Write(Level level, const char* fmt, Args&&... args) {
+        static_assert(sizeof...(Args) <= kMaxArgs, "too many log arguments");
+        Record* r = Detail::Begin();
+        if (!r) return;
+        r->level = level;
+        r->fmt = fmt;
+        r->argc = static_cast<uint8_t>(sizeof...(Args));
+        r->textUsed = 0;
+        [[maybe_unused]] int i = 0;
+        (Detail::StoreArg(*r, i++, std::forward<Args>(args)), ...);
+        Detail::Commit(level);
+    }
+}
+
+#define WOL_LOG(level, ...)                                                   \
+    do {                                                                      \
+        if constexpr (static_cast<int>(level) >= WOLSKILL_LOG_MIN_LEVEL) {    \
+            if (::Log::IsEnabled(level)) ::Log::Write(level, __VA_ARGS__);    \
+        }                                                                     \
+    } while (0)
+
+#define LOG_TRACE(...) WOL_LOG(::Log::Level::Trace, __VA_ARGS__)
+#define LOG_DEBUG(...) WOL_LOG(::Log::Level::Debug, __VA_ARGS__)
+#define LOG_INFO(...)  WOL_LOG(::Log::Level::Info, __VA_ARGS__)
+#define LOG_WARN(...)  WOL_LOG(::Log::Level::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) WOL_LOG(::Log::Level::Error, __VA_ARGS__)
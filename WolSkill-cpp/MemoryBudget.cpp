@@ -0,0 +1,158 @@
+#include "MemoryBudget.h"
+#include "MessageDispatcher.h"
+#include "WebSocketClient.h"
+#include "Log.h"
+#include <psapi.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+#pragma comment(lib, "psapi.lib")
+
+// Trimming forces the next cycle to soft-fault its pages back in, so not every report
+static constexpr ULONGLONG TRIM_INTERVAL_MS = 5 * 60 * 1000;
+// Cycles before the counters are trusted: first reports size the reusable buffers
+static constexpr int WARMUP_CYCLES = 3;
+
+static int g_cycles = 0;
+static bool g_overBudget = false;
+static ULONGLONG g_lastTrim = 0;
+
+// ---------- Counting allocator ----------
+#ifdef WOLSKILL_COUNT_ALLOCATIONS
+static std::atomic<uint64_t> g_allocations{ 0 };
+static thread_local uint64_t t_allocations = 0;
+
+// Every replaceable form is defined, rather than relying on the runtime's array and nothrow
+// forms to forward to operator new(size_t): its aligned forms (types over 16-byte alignment,
+// such as the log rings) go straight to _aligned_malloc and would not be counted.
+static void* Allocate(std::size_t size) noexcept {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    ++t_allocations;
+    return std::malloc(size ? size : 1);
+}
+
+static void* Allocate(std::size_t size, std::align_val_t align) noexcept {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    ++t_allocations;
+    return _aligned_malloc(size ? size : 1, static_cast<std::size_t>(align));
+}
+
+void* operator new(std::size_t size) {
+    if (void* p = Allocate(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) {
+    if (void* p = Allocate(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t size, std::align_val_t align) {
+    if (void* p = Allocate(size, align)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size, std::align_val_t align) {
+    if (void* p = Allocate(size, align)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return Allocate(size, align); }
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return Allocate(size, align); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { _aligned_free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { _aligned_free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { _aligned_free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { _aligned_free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { _aligned_free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { _aligned_free(p); }
+
+uint64_t MemoryBudget::AllocationCount() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t MemoryBudget::ThreadAllocationCount() {
+    return t_allocations;
+}
+#else
+uint64_t MemoryBudget::AllocationCount() { return 0; }
+uint64_t MemoryBudget::ThreadAllocationCount() { return 0; }
+#endif
+
+SIZE_T MemoryBudget::PrivateBytes() {
+    PROCESS_MEMORY_COUNTERS_EX pmc{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(),
+        reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&pmc), sizeof(pmc)))
+        return 0;
+    return pmc.PrivateUsage;
+}
+
+void MemoryBudget::OnReportCycle(uint64_t allocations) {
+    if (++g_cycles > WARMUP_CYCLES) {
+        SIZE_T privateBytes = PrivateBytes();
+        bool over = allocations > kMaxAllocationsPerCycle || privateBytes > kMaxPrivateBytes;
+        // Warn when the budget is first exceeded, not on every cycle after
+        if (over && !g_overBudget)
+            LOG_WARN("Memory budget exceeded: {} allocations in the last report (budget {}), {} private bytes (budget {})",
+                allocations, kMaxAllocationsPerCycle, privateBytes, kMaxPrivateBytes);
+        else if (over)
+            LOG_DEBUG("Memory budget still exceeded: {} allocations, {} private bytes", allocations, privateBytes);
+        else if (g_overBudget)
+            LOG_INFO("Memory back within budget: {} private bytes", privateBytes);
+        g_overBudget = over;
+    }
+
+    ULONGLONG now = GetTickCount64();
+    if (now - g_lastTrim >= TRIM_INTERVAL_MS) {
+        TrimWorkingSet();
+        g_lastTrim = now;
+    }
+}
+
+void MemoryBudget::TrimWorkingSet() {
+    SetProcessWorkingSetSize(GetCurrentProcess(), static_cast<SIZE_T>(-1), static_cast<SIZE_T>(-1));
+}
+
+// ---------- Offline check ----------
+int MemoryBudget::RunCheck(int cycles, void (*sendReport)()) {
+    static const char pong[] = "{\"value\":\"pong\"}";
+
+    MessageDispatcher dispatcher;
+    dispatcher.Start([](const std::string&) {});
+
+    // One cycle as the tray app runs it: build and send the report (offline the client is
+    // not connected, so it is built but not sent), then receive and dispatch the pong
+    auto cycle = [&] {
+        sendReport();
+
+        std::string msg = dispatcher.Acquire();
+        msg.append(pong);
+        uint64_t expected = dispatcher.GetStats().handled + 1;
+        dispatcher.Post(std::move(msg), WebSocketClient::IsControlMessage(pong));
+        // The handled count and the buffer's return to the pool are updated together
+        while (dispatcher.GetStats().handled < expected) Sleep(0);
+    };
+
+    for (int i = 0; i < WARMUP_CYCLES; ++i) cycle();
+    uint64_t before = AllocationCount();
+    for (int i = 0; i < cycles; ++i) cycle();
+    uint64_t allocations = AllocationCount() - before;
+    dispatcher.Stop();
+
+    SIZE_T privateBytes = PrivateBytes();
+    double perCycle = cycles > 0 ? static_cast<double>(allocations) / cycles : 0.0;
+    bool ok = perCycle <= static_cast<double>(kMaxAllocationsPerCycle) && privateBytes <= kMaxPrivateBytes;
+    if (!kCountsAllocations)
+        std::printf("Allocations are not counted in this build (define WOLSKILL_COUNT_ALLOCATIONS)\n");
+    std::printf("%d cycles: %.2f allocations/cycle (budget %llu), %zu KiB private (budget %zu KiB) - %s\n",
+        cycles, perCycle, static_cast<unsigned long long>(kMaxAllocationsPerCycle),
+        privateBytes / 1024, kMaxPrivateBytes / 1024, ok ? "ok" : "OVER BUDGET");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <Windows.h>
+#include <cstdint>
+
+// Memory budget of the low-memory mode (LowMemory = 1).
+//
+// Builds with WOLSKILL_COUNT_ALLOCATIONS (the Debug configurations) replace
+// every form of operator new in MemoryBudget.cpp to count C++ heap
+// allocations, in total and per thread; other builds keep the runtime's
+// allocator and report no allocations. In low-memory mode the tray window
+// passes OnReportCycle() what building and sending a report allocated on its
+// own thread, so other threads (log flush, neighbor sweep, WinHTTP callbacks)
+// cannot trip the check: once warmed up, a report must not allocate and
+// private bytes must stay under kMaxPrivateBytes, or a warning is logged. The
+// working set is trimmed at most every few minutes, since the process then
+// sleeps until the next timer. RunCheck() drives the tray app's own report
+// function offline for `WolSkill-cpp.exe --check-budget`, which the Debug
+// configurations run after every build.
+namespace MemoryBudget {
+    static constexpr SIZE_T kMaxPrivateBytes = 6 * 1024 * 1024;
+    static constexpr uint64_t kMaxAllocationsPerCycle = 0;
+#ifdef WOLSKILL_COUNT_ALLOCATIONS
+    static constexpr bool kCountsAllocations = true;
+#else
+    static constexpr bool kCountsAllocations = false;
+#endif
+
+    uint64_t AllocationCount();
+    // Allocations made by the calling thread
+    uint64_t ThreadAllocationCount();
+    SIZE_T PrivateBytes();
+
+    // `allocations`: what the report just sent allocated on the window thread
+    void OnReportCycle(uint64_t allocations);
+    void TrimWorkingSet();
+
+    // Runs `cycles` report/pong cycles after a warm-up, each calling `sendReport`,
+    // prints the result and returns the process exit code: 0 if within budget
+    int RunCheck(int cycles, void (*sendReport)());
+}
@@ -0,0 +1,160 @@
+#include "MessageDispatcher.h"
+#include "Log.h"
+
+// Handling slower than this is logged, since it holds up every message behind it
+static constexpr uint64_t SLOW_HANDLER_US = 100 * 1000;
+
+MessageDispatcher::~MessageDispatcher() {
+    Stop();
+    if (m_abandoned.joinable()) m_abandoned.join();
+}
+
+void MessageDispatcher::Start(Handler handler) {
+    Stop();
+    uint64_t generation;
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = false;
+        m_running = true;
+        generation = ++m_generation;
+    }
+    m_cv.notify_all(); // An abandoned handler thread sees it has been replaced
+    m_thread = std::thread(&MessageDispatcher::Run, this, std::move(handler), std::move(m_abandoned), generation);
+}
+
+void MessageDispatcher::RequestStop() {
+    size_t discarded;
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_stop) return;
+        m_stop = true;
+        m_running = false;
+        discarded = m_normal.size();
+        m_normal.clear();
+        m_stats.discarded += discarded;
+        m_stats.depth = m_control.size();
+        m_throttling = false;
+    }
+    m_cv.notify_all();
+    m_room.notify_all(); // Releases a receive thread held by backpressure
+    if (discarded) LOG_INFO("Dispatcher stopping: {} queued commands discarded", discarded);
+}
+
+bool MessageDispatcher::Stop(DWORD timeoutMs) {
+    if (!m_thread.joinable()) return true;
+    RequestStop();
+    if (timeoutMs != INFINITE &&
+        WaitForSingleObject(m_thread.native_handle(), timeoutMs) == WAIT_TIMEOUT) {
+        LOG_WARN("Message handler still running after {} ms, leaving it to finish", timeoutMs);
+        m_abandoned = std::move(m_thread);
+        return false;
+    }
+    m_thread.join();
+    return true;
+}
+
+bool MessageDispatcher::Post(std::string msg, bool control) {
+    {
+        std::unique_lock lock(m_mutex);
+        if (control) {
+            if (m_stop) return false;
+            if (m_control.size() >= kMaxQueuedMessages) {
+                m_control.pop_front();
+                ++m_stats.dropped;
+                LOG_WARN("Dispatcher control lane full, dropped oldest pong");
+            }
+            m_control.push_back({ std::move(msg), Clock::now() });
+        } else {
+            if (!m_running) {
+                ++m_stats.discarded;
+                LOG_DEBUG("Dispatcher stopping, command not handled ({} bytes)", msg.size());
+                return false;
+            }
+            // Backpressure: the receive thread waits for the handler rather than losing a command
+            if (m_normal.size() >= kMaxQueuedMessages) {
+                ++m_stats.waited;
+                if (!m_throttling) LOG_WARN("Dispatcher normal lane full, holding the receive thread");
+                m_throttling = true;
+                m_room.wait_for(lock, kPostWait,
+                    [this] { return !m_running || m_normal.size() < kMaxQueuedMessages; });
+            }
+            if (!m_running) {
+                ++m_stats.discarded;
+                return false;
+            }
+            if (m_normal.size() >= kMaxQueuedMessages) {
+                ++m_stats.rejected;
+                LOG_ERROR("Dispatcher rejected a command ({} bytes): queue still full", msg.size());
+                return false;
+            }
+            m_normal.push_back({ std::move(msg), Clock::now() });
+        }
+        m_stats.depth = m_control.size() + m_normal.size();
+        if (m_stats.depth > m_stats.maxDepth) m_stats.maxDepth = m_stats.depth;
+    }
+    m_cv.notify_one();
+    return true;
+}
+
+std::string MessageDispatcher::Acquire() {
+    std::lock_guard lock(m_mutex);
+    if (m_spare.empty()) return {};
+    std::string buffer = std::move(m_spare.back());
+    m_spare.pop_back();
+    return buffer;
+}
+
+MessageDispatcher::Stats MessageDispatcher::GetStats() const {
+    std::lock_guard lock(m_mutex);
+    return m_stats;
+}
+
+void MessageDispatcher::Run(Handler handler, std::thread previous, uint64_t generation) {
+    // A handler left running by a Stop() that timed out finishes before this one starts
+    if (previous.joinable()) previous.join();
+
+    for (;;) {
+        Item item;
+        {
+            std::unique_lock lock(m_mutex);
+            m_cv.wait(lock, [&] {
+                return m_stop || generation != m_generation || !m_control.empty() || !m_normal.empty();
+            });
+            // Replaced by a later Start(), or stopping with no pong left to hand over
+            if (generation != m_generation || (m_stop && m_control.empty())) return;
+            auto& lane = !m_control.empty() ? m_control : m_normal;
+            item = std::move(lane.front());
+            lane.pop_front();
+            m_stats.depth = m_control.size() + m_normal.size();
+            if (m_normal.empty()) m_throttling = false;
+        }
+        m_room.notify_one();
+
+        auto started = Clock::now();
+        if (handler) handler(item.msg);
+        auto finished = Clock::now();
+
+        auto queueUs = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(started - item.enqueued).count());
+        auto handleUs = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(finished - started).count());
+        size_t depth;
+        {
+            std::lock_guard lock(m_mutex);
+            ++m_stats.handled;
+            if (m_spare.size() < kSpareBuffers) {
+                item.msg.clear();
+                m_spare.push_back(std::move(item.msg));
+            }
+            m_stats.lastQueueUs = queueUs;
+            m_stats.lastHandleUs = handleUs;
+            if (queueUs > m_stats.maxQueueUs) m_stats.maxQueueUs = queueUs;
+            if (handleUs > m_stats.maxHandleUs) m_stats.maxHandleUs = handleUs;
+            depth = m_stats.depth;
+        }
+
+        LOG_TRACE("dispatch: queued {} us, handled {} us, depth {}", queueUs, handleUs, depth);
+        if (handleUs > SLOW_HANDLER_US)
+            LOG_WARN("Slow message handler: {} us ({} still queued)", handleUs, depth);
+    }
+}
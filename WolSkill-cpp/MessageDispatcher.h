@@ -0,0 +1,100 @@
+#pragma once
+#include <Windows.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Handler stage between the WebSocket receive loop and the application.
+//
+// The receive loop only frames messages and calls Post(); a dedicated thread
+// runs the handler, so slow handling (adapter enumeration, shutdown) never
+// delays reading further frames. Control messages (pong) have their own
+// queue that is always drained first.
+//
+// While running, only control messages are ever dropped: a lost pong is
+// covered by the next report. A command is never dropped silently. When the
+// normal lane is full, Post() holds the receive thread until there is room,
+// which also stops reading from the socket. If the lane stays full for
+// kPostWait, the command is rejected and logged as an error.
+//
+// Stopping is bounded. RequestStop() discards the queued commands, which
+// arrived on a connection that is being torn down, and returns at once; the
+// queued pongs are still handled. Who blocks, and for how long:
+//  - Post() (receive thread): up to kPostWait while the normal lane is full,
+//    and not at all once a stop has been requested.
+//  - Stop(timeoutMs): up to timeoutMs for the handler already running. One
+//    that takes longer is left to finish; the next Start() joins it on the new
+//    handler thread, and the destructor waits for it.
+class MessageDispatcher {
+public:
+    using Handler = std::function<void(const std::string& msg)>;
+
+    static constexpr size_t kMaxQueuedMessages = 256; // Per lane
+    static constexpr size_t kSpareBuffers = 4;        // Handled message buffers kept for reuse
+    static constexpr std::chrono::milliseconds kPostWait{ 1000 }; // Longest Post() waits for room
+
+    struct Stats {
+        size_t depth = 0;            // Messages currently queued (both lanes)
+        size_t maxDepth = 0;
+        uint64_t handled = 0;
+        uint64_t dropped = 0;        // Pongs dropped from a full control lane
+        uint64_t waited = 0;         // Commands that waited for room in the normal lane
+        uint64_t rejected = 0;       // Commands refused because the lane stayed full
+        uint64_t discarded = 0;      // Commands dropped because the dispatcher was stopping
+        uint64_t lastQueueUs = 0;    // Time the last message waited before handling
+        uint64_t maxQueueUs = 0;
+        uint64_t lastHandleUs = 0;   // Time the handler took for the last message
+        uint64_t maxHandleUs = 0;
+    };
+
+    MessageDispatcher() { m_spare.reserve(kSpareBuffers); }
+    ~MessageDispatcher();
+
+    MessageDispatcher(const MessageDispatcher&) = delete;
+    MessageDispatcher& operator=(const MessageDispatcher&) = delete;
+
+    void Start(Handler handler);
+    // Discards the queued commands and refuses new ones; does not wait
+    void RequestStop();
+    // RequestStop(), then waits for the handler thread at most `timeoutMs`. False if the
+    // handler still runs; it is left to finish on its own.
+    bool Stop(DWORD timeoutMs = INFINITE);
+    // False if the message was dropped or rejected
+    bool Post(std::string msg, bool control);
+    // An empty buffer for the next message, reusing the capacity of one already handled,
+    // so a steady stream of messages does not allocate
+    std::string Acquire();
+    Stats GetStats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Item {
+        std::string msg;
+        Clock::time_point enqueued;
+    };
+
+    void Run(Handler handler, std::thread previous, uint64_t generation);
+
+    std::thread m_thread;
+    // A handler thread that missed the Stop() deadline; joined before the next one takes
+    // messages, or by the destructor
+    std::thread m_abandoned;
+    uint64_t m_generation = 0;         // Bumped by Start(); an older handler thread exits
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::condition_variable m_room;    // Signalled when the normal lane shrinks
+    std::deque<Item> m_control;
+    std::deque<Item> m_normal;
+    std::vector<std::string> m_spare;
+    bool m_stop = false;
+    bool m_running = false;            // Commands are accepted; cleared by RequestStop()
+    bool m_throttling = false;         // Post() waited since the normal lane was last empty
+    Stats m_stats;
+};
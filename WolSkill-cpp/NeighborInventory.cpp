@@ -0,0 +1,247 @@
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <iphlpapi.h>
+#include <netioapi.h>
+#include "NeighborInventory.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstring>
+
+#pragma comment(lib, "iphlpapi.lib")
+#pragma comment(lib, "ws2_32.lib")
+
+// Re-sweep (and re-read) this often even without network changes, so hosts that appear
+// later are found
+static constexpr DWORD SWEEP_INTERVAL_MS = 30 * 60 * 1000;
+static constexpr u_short PROBE_PORT = 9; // Discard; nothing is expected back
+
+// Order by family, then address bytes
+static bool AddressLess(USHORT lf, const BYTE* la, USHORT rf, const BYTE* ra) {
+    if (lf != rf) return lf < rf;
+    return std::memcmp(la, ra, 16) < 0;
+}
+
+// Entries worth reporting: resolved unicast neighbors
+static bool IsUsable(const MIB_IPNET_ROW2& row) {
+    if (row.PhysicalAddressLength == 0 || row.PhysicalAddressLength > 8) return false;
+    if (row.PhysicalAddress[0] & 0x01) return false; // Multicast or broadcast MAC
+    switch (row.State) {
+    case NlnsReachable:
+    case NlnsStale:
+    case NlnsDelay:
+    case NlnsProbe:
+    case NlnsPermanent:
+        return true;
+    default:
+        return false; // Unreachable or incomplete: a probe that went unanswered
+    }
+}
+
+// Waits until a probe may be sent; false if the sweep is being stopped
+class TokenBucket {
+public:
+    TokenBucket(double rate, double burst) : m_rate(rate), m_burst(burst), m_tokens(burst) {}
+
+    bool Take(HANDLE stopEvent) {
+        for (;;) {
+            ULONGLONG now = GetTickCount64();
+            m_tokens = min(m_burst, m_tokens + static_cast<double>(now - m_last) * m_rate / 1000.0);
+            m_last = now;
+            if (m_tokens >= 1.0) {
+                m_tokens -= 1.0;
+                return true;
+            }
+            DWORD waitMs = static_cast<DWORD>((1.0 - m_tokens) * 1000.0 / m_rate) + 1;
+            if (WaitForSingleObject(stopEvent, waitMs) == WAIT_OBJECT_0) return false;
+        }
+    }
+
+private:
+    double m_rate;
+    double m_burst;
+    double m_tokens;
+    ULONGLONG m_last = GetTickCount64();
+};
+
+NeighborInventory::~NeighborInventory() {
+    StopSweeper();
+}
+
+void NeighborInventory::SetMode(Mode mode) {
+    if (mode > Mode::Active) mode = Mode::Off;
+    if (mode == m_mode) return;
+    LOG_INFO("Neighbor inventory mode {} -> {}", static_cast<DWORD>(m_mode), static_cast<DWORD>(mode));
+
+    StopSweeper();
+    m_mode = mode;
+    if (m_mode == Mode::Off) {
+        m_current.clear();
+        m_current.shrink_to_fit();
+        m_scratch.clear();
+        m_scratch.shrink_to_fit();
+    } else {
+        StartSweeper();
+    }
+}
+
+void NeighborInventory::RequestSweep() {
+    if (m_sweepEvent) SetEvent(m_sweepEvent);
+}
+
+bool NeighborInventory::Refresh() {
+    if (m_mode == Mode::Off) return false;
+
+    PMIB_IPNET_TABLE2 table = nullptr;
+    if (GetIpNetTable2(AF_UNSPEC, &table) != NO_ERROR) return false;
+
+    m_scratch.clear();
+    for (ULONG i = 0; i < table->NumEntries; ++i) {
+        const MIB_IPNET_ROW2& row = table->Table[i];
+        if (!IsUsable(row)) continue;
+
+        Neighbor n;
+        n.family = row.Address.si_family;
+        if (n.family == AF_INET)
+            std::memcpy(n.addr, &row.Address.Ipv4.sin_addr, 4);
+        else if (n.family == AF_INET6)
+            std::memcpy(n.addr, &row.Address.Ipv6.sin6_addr, 16);
+        else
+            continue;
+        n.macLength = row.PhysicalAddressLength;
+        std::memcpy(n.mac, row.PhysicalAddress, n.macLength);
+        n.ifIndex = row.InterfaceIndex;
+        m_scratch.push_back(n);
+    }
+    FreeMibTable(table);
+
+    // The same address can be on two interfaces; the index keeps the order stable between reads
+    std::sort(m_scratch.begin(), m_scratch.end(), [](const Neighbor& l, const Neighbor& r) {
+        if (AddressLess(l.family, l.addr, r.family, r.addr)) return true;
+        if (AddressLess(r.family, r.addr, l.family, l.addr)) return false;
+        return l.ifIndex < r.ifIndex;
+    });
+    if (m_scratch == m_current) return false;
+
+    // Walk both sorted tables to log what changed
+    size_t added = 0, removed = 0, changed = 0;
+    size_t i = 0, j = 0;
+    while (i < m_current.size() || j < m_scratch.size()) {
+        if (j == m_scratch.size() ||
+            (i < m_current.size() && AddressLess(m_current[i].family, m_current[i].addr, m_scratch[j].family, m_scratch[j].addr))) {
+            ++removed; ++i;
+        } else if (i == m_current.size() ||
+            AddressLess(m_scratch[j].family, m_scratch[j].addr, m_current[i].family, m_current[i].addr)) {
+            ++added; ++j;
+        } else {
+            if (!(m_current[i] == m_scratch[j])) ++changed;
+            ++i; ++j;
+        }
+    }
+    LOG_INFO("Neighbors: {} total, {} added, {} removed, {} changed", m_scratch.size(), added, removed, changed);
+
+    m_current.swap(m_scratch);
+    return true;
+}
+
+void NeighborInventory::WriteJson(Json::Writer& writer) const {
+    writer.BeginArray();
+    for (const Neighbor& n : m_current) {
+        char ip[INET6_ADDRSTRLEN]{};
+        inet_ntop(n.family, n.addr, ip, sizeof(ip));
+
+        char mac[24];
+        char* p = mac;
+        for (ULONG k = 0; k < n.macLength; ++k) {
+            if (k > 0) *p++ = ':';
+            Json::HexDigits(p, n.mac[k], 2);
+            p += 2;
+        }
+        *p = '\0';
+
+        writer.BeginObject();
+        writer.Field<"mac">(mac);
+        writer.Field<"ip">(ip);
+        writer.EndObject();
+    }
+    writer.EndArray();
+}
+
+// ---------- Background sweep and refresh ----------
+void NeighborInventory::StartSweeper() {
+    m_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    m_sweepEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    if (!m_stopEvent || !m_sweepEvent) {
+        StopSweeper();
+        return;
+    }
+    m_thread = std::thread(&NeighborInventory::SweepThread, this);
+}
+
+void NeighborInventory::StopSweeper() {
+    if (m_stopEvent) SetEvent(m_stopEvent);
+    if (m_thread.joinable()) m_thread.join();
+    if (m_stopEvent) { CloseHandle(m_stopEvent); m_stopEvent = nullptr; }
+    if (m_sweepEvent) { CloseHandle(m_sweepEvent); m_sweepEvent = nullptr; }
+}
+
+void NeighborInventory::SweepThread() {
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return;
+
+    HANDLE events[] = { m_stopEvent, m_sweepEvent };
+    DWORD wait = WAIT_TIMEOUT; // Sweep and read once at start
+    while (wait != WAIT_OBJECT_0) {
+        if (m_mode == Mode::Active) Sweep();
+        // The table itself is read on the window thread, which owns it
+        if (m_notifyWnd) PostMessageW(m_notifyWnd, m_notifyMsg, 0, 0);
+        wait = WaitForMultipleObjects(2, events, FALSE, SWEEP_INTERVAL_MS);
+    }
+    WSACleanup();
+}
+
+void NeighborInventory::Sweep() {
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET) return;
+    u_long nonBlocking = 1;
+    ioctlsocket(s, FIONBIO, &nonBlocking);
+
+    PMIB_UNICASTIPADDRESS_TABLE table = nullptr;
+    if (GetUnicastIpAddressTable(AF_INET, &table) != NO_ERROR) {
+        closesocket(s);
+        return;
+    }
+
+    ULONGLONG start = GetTickCount64();
+    TokenBucket bucket(kProbesPerSecond, kProbeBurst);
+    size_t probes = 0;
+    bool stopped = false;
+    for (ULONG i = 0; i < table->NumEntries && !stopped; ++i) {
+        const MIB_UNICASTIPADDRESS_ROW& row = table->Table[i];
+        ULONG own = ntohl(row.Address.Ipv4.sin_addr.s_addr);
+        BYTE prefix = row.OnLinkPrefixLength;
+        if ((own >> 24) == 127 || (own >> 16) == 0xA9FE) continue; // Loopback, link-local
+        if (prefix == 0 || prefix > 30) continue;
+        if (prefix < kWidestSweepPrefix) prefix = kWidestSweepPrefix;
+
+        ULONG mask = ~0UL << (32 - prefix);
+        ULONG network = own & mask;
+        ULONG broadcast = network | ~mask;
+        for (ULONG host = network + 1; host < broadcast; ++host) {
+            if (host == own) continue;
+            if (!bucket.Take(m_stopEvent)) { stopped = true; break; }
+
+            sockaddr_in to{};
+            to.sin_family = AF_INET;
+            to.sin_port = htons(PROBE_PORT);
+            to.sin_addr.s_addr = htonl(host);
+            // Only the ARP resolution this triggers matters; send errors are expected
+            sendto(s, "", 0, 0, reinterpret_cast<const sockaddr*>(&to), sizeof(to));
+            ++probes;
+        }
+    }
+    FreeMibTable(table);
+    closesocket(s);
+
+    LOG_INFO("Neighbor sweep: {} probes in {} ms{}", probes, GetTickCount64() - start,
+        stopped ? " (stopped)" : "");
+}
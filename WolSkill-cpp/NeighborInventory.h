@@ -0,0 +1,74 @@
+#pragma once
+#include <Windows.h>
+#include <thread>
+#include <vector>
+#include "JsonWriter.h"
+
+// Inventory of the MAC/IP pairs on the local segments, read from the OS
+// neighbor (ARP/NDP) table.
+//
+// Passive mode only reads the table; Refresh() diffs it against the last
+// read into reused buffers, so an unchanged table costs one GetIpNetTable2
+// call and a compare, and only changes are logged and swapped in.
+// Active mode also sweeps each IPv4 subnet from a background thread: an
+// empty UDP datagram to port 9 (discard) makes the kernel resolve every
+// address, so probes are pipelined without waiting on each ARP reply, and a
+// token bucket keeps the rate at kProbesPerSecond. A /22 takes about 4 s.
+//
+// Reports only write the last read. The background thread posts the notify
+// message when the table should be re-read: after each sweep in active
+// mode, and after network changes and every 30 minutes in both modes.
+class NeighborInventory {
+public:
+    enum class Mode : DWORD { Off = 0, Passive = 1, Active = 2 };
+
+    static constexpr DWORD kProbesPerSecond = 256;
+    static constexpr DWORD kProbeBurst = 16;
+    static constexpr BYTE kWidestSweepPrefix = 22; // Wider subnets sweep the /22 around our address
+
+    NeighborInventory() = default;
+    ~NeighborInventory();
+
+    NeighborInventory(const NeighborInventory&) = delete;
+    NeighborInventory& operator=(const NeighborInventory&) = delete;
+
+    // Window message that asks for Refresh(); set before SetMode()
+    void SetNotify(HWND hWnd, UINT msg) { m_notifyWnd = hWnd; m_notifyMsg = msg; }
+    // Window thread only, like Refresh() and WriteJson()
+    void SetMode(Mode mode);
+    Mode GetMode() const { return m_mode; }
+    // Addresses or subnets changed: sweep again now (active mode) and re-read the table
+    void RequestSweep();
+
+    // Re-reads the neighbor table; returns true if it differs from the previous read
+    bool Refresh();
+    size_t Count() const { return m_current.size(); }
+    // Array of {"mac","ip"}, ordered by address
+    void WriteJson(Json::Writer& writer) const;
+
+private:
+    struct Neighbor {
+        USHORT family = 0;
+        BYTE addr[16]{};
+        BYTE mac[8]{};
+        ULONG macLength = 0;
+        ULONG ifIndex = 0;
+
+        bool operator==(const Neighbor&) const = default;
+    };
+
+    void StartSweeper();
+    void StopSweeper();
+    void SweepThread();
+    void Sweep();
+
+    Mode m_mode = Mode::Off;
+    std::vector<Neighbor> m_current;
+    std::vector<Neighbor> m_scratch; // Swapped with m_current when the table changes
+
+    std::thread m_thread;
+    HANDLE m_stopEvent = nullptr;
+    HANDLE m_sweepEvent = nullptr;
+    HWND m_notifyWnd = nullptr;
+    UINT m_notifyMsg = 0;
+};
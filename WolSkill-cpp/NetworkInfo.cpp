@@ -2,115 +2,102 @@
 #include <ws2tcpip.h>
 #include <iphlpapi.h>
 #include "NetworkInfo.h"
-#include <sstream>
-#include <iomanip>
+#include <algorithm>
+#include <cctype>
 
 #pragma comment(lib, "iphlpapi.lib")
 #pragma comment(lib, "ws2_32.lib")
 
-static std::string FormatMac(const BYTE* addr, DWORD len) {
-    std::ostringstream ss;
-    for (DWORD i = 0; i < len; ++i) {
-        if (i > 0) ss << ':';
-        ss << std::hex << std::setfill('0') << std::setw(2)
-           << static_cast<int>(addr[i]);
-    }
-    return ss.str();
-}
+static constexpr ULONG INITIAL_BUFFER_SIZE = 15000;
 
-static std::string EscapeJson(const std::string& s) {
-    std::string out;
-    out.reserve(s.size());
-    for (char c : s) {
-        if (c == '"') out += "\\\"";
-        else if (c == '\\') out += "\\\\";
-        else out += c;
+static void FormatMac(char* out, const BYTE* addr, DWORD len) {
+    for (DWORD i = 0; i < len; ++i) {
+        if (i > 0) *out++ = ':';
+        Json::HexDigits(out, addr[i], 2);
+        out += 2;
     }
-    return out;
+    *out = '\0';
 }
 
-std::map<std::string, AdapterInfo> GetAllAdapters() {
-    std::map<std::string, AdapterInfo> result;
+bool AdapterSnapshot::Refresh() {
+    m_count = 0;
+    m_order.clear();
+    if (m_buffer.empty()) m_buffer.resize(INITIAL_BUFFER_SIZE);
 
-    ULONG bufLen = 15000;
-    auto* addrs = static_cast<PIP_ADAPTER_ADDRESSES>(malloc(bufLen));
-    if (!addrs) return result;
-
-    ULONG flags = GAA_FLAG_INCLUDE_PREFIX;
-    if (GetAdaptersAddresses(AF_UNSPEC, flags, nullptr, addrs, &bufLen) == ERROR_BUFFER_OVERFLOW) {
-        free(addrs);
-        addrs = static_cast<PIP_ADAPTER_ADDRESSES>(malloc(bufLen));
-        if (!addrs) return result;
-    }
-
-    if (GetAdaptersAddresses(AF_UNSPEC, flags, nullptr, addrs, &bufLen) != NO_ERROR) {
-        free(addrs);
-        return result;
+    // DNS, multicast and anycast lists are not reported; skipping them keeps the buffer small
+    ULONG flags = GAA_FLAG_INCLUDE_PREFIX | GAA_FLAG_SKIP_DNS_SERVER |
+        GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_ANYCAST;
+    auto* addrs = reinterpret_cast<PIP_ADAPTER_ADDRESSES>(m_buffer.data());
+    ULONG bufLen = static_cast<ULONG>(m_buffer.size());
+    ULONG err = GetAdaptersAddresses(AF_UNSPEC, flags, nullptr, addrs, &bufLen);
+    // An adapter can appear between the two calls, so allow a second resize
+    for (int attempt = 0; err == ERROR_BUFFER_OVERFLOW && attempt < 2; ++attempt) {
+        m_buffer.resize(bufLen);
+        addrs = reinterpret_cast<PIP_ADAPTER_ADDRESSES>(m_buffer.data());
+        err = GetAdaptersAddresses(AF_UNSPEC, flags, nullptr, addrs, &bufLen);
     }
+    if (err != NO_ERROR) return false;
 
     for (auto* cur = addrs; cur; cur = cur->Next) {
         if (cur->PhysicalAddressLength == 0) continue;
         if (cur->IfType == IF_TYPE_SOFTWARE_LOOPBACK) continue;
 
-        AdapterInfo info;
-        info.mac = FormatMac(cur->PhysicalAddress, cur->PhysicalAddressLength);
+        if (m_count == m_adapters.size()) m_adapters.emplace_back();
+        Adapter& a = m_adapters[m_count++];
+        FormatMac(a.mac, cur->PhysicalAddress, min(cur->PhysicalAddressLength, static_cast<ULONG>(MAX_ADAPTER_ADDRESS_LENGTH)));
 
         // Get IP addresses
+        a.ipv4[0] = '\0';
+        a.ipv6[0] = '\0';
         for (auto* ua = cur->FirstUnicastAddress; ua; ua = ua->Next) {
-            char buf[128]{};
             auto* sa = ua->Address.lpSockaddr;
-            if (sa->sa_family == AF_INET) {
-                inet_ntop(AF_INET, &reinterpret_cast<sockaddr_in*>(sa)->sin_addr, buf, sizeof(buf));
-                info.ipv4 = buf;
-            } else if (sa->sa_family == AF_INET6) {
-                inet_ntop(AF_INET6, &reinterpret_cast<sockaddr_in6*>(sa)->sin6_addr, buf, sizeof(buf));
-                info.ipv6 = buf;
-            }
+            if (sa->sa_family == AF_INET)
+                inet_ntop(AF_INET, &reinterpret_cast<sockaddr_in*>(sa)->sin_addr, a.ipv4, sizeof(a.ipv4));
+            else if (sa->sa_family == AF_INET6)
+                inet_ntop(AF_INET6, &reinterpret_cast<sockaddr_in6*>(sa)->sin6_addr, a.ipv6, sizeof(a.ipv6));
         }
 
-        // Convert friendly name from wide to narrow
+        // Convert friendly name from wide to narrow, into the string's existing capacity
         int len = WideCharToMultiByte(CP_UTF8, 0, cur->FriendlyName, -1, nullptr, 0, nullptr, nullptr);
-        std::string name(len - 1, 0);
-        WideCharToMultiByte(CP_UTF8, 0, cur->FriendlyName, -1, name.data(), len, nullptr, nullptr);
-
-        result[name] = info;
+        a.name.resize(len > 0 ? len - 1 : 0);
+        if (len > 1)
+            WideCharToMultiByte(CP_UTF8, 0, cur->FriendlyName, -1, a.name.data(), len, nullptr, nullptr);
     }
 
-    free(addrs);
-    return result;
+    // Sort by name like the std::map this used to fill; on duplicate names the later adapter wins
+    for (size_t i = 0; i < m_count; ++i) m_order.push_back(i);
+    std::sort(m_order.begin(), m_order.end(), [this](size_t l, size_t r) {
+        int c = m_adapters[l].name.compare(m_adapters[r].name);
+        return c != 0 ? c < 0 : l > r;
+    });
+    m_order.erase(std::unique(m_order.begin(), m_order.end(), [this](size_t l, size_t r) {
+        return m_adapters[l].name == m_adapters[r].name;
+    }), m_order.end());
+    return true;
 }
 
-std::string GetAdaptersJson() {
-    auto adapters = GetAllAdapters();
-    std::ostringstream ss;
-    ss << "{";
-    bool first = true;
-    for (auto& [name, info] : adapters) {
-        if (!first) ss << ",";
-        first = false;
-        ss << "\"" << EscapeJson(name) << "\":{";
-        ss << "\"mac\":\"" << EscapeJson(info.mac) << "\"";
-        if (!info.ipv4.empty())
-            ss << ",\"ipv4\":\"" << EscapeJson(info.ipv4) << "\"";
-        if (!info.ipv6.empty())
-            ss << ",\"ipv6\":\"" << EscapeJson(info.ipv6) << "\"";
-        ss << "}";
+void AdapterSnapshot::WriteMembers(Json::Writer& writer) const {
+    for (size_t i : m_order) {
+        const Adapter& a = m_adapters[i];
+        writer.Key(a.name);
+        writer.BeginObject();
+        writer.Field<"mac">(a.mac);
+        if (a.ipv4[0]) writer.Field<"ipv4">(a.ipv4);
+        if (a.ipv6[0]) writer.Field<"ipv6">(a.ipv6);
+        writer.EndObject();
     }
-    ss << "}";
-    return ss.str();
 }
 
-std::vector<std::string> GetLocalMacAddresses() {
-    std::vector<std::string> macs;
-    auto adapters = GetAllAdapters();
-    for (auto& [name, info] : adapters) {
-        // Convert to uppercase XX-XX-XX-XX-XX-XX format (matching the Node.js behavior)
-        std::string mac = info.mac;
-        for (auto& c : mac) {
-            if (c == ':') c = '-';
-            else c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+bool AdapterSnapshot::HasMac(std::string_view mac) const {
+    for (size_t i = 0; i < m_count; ++i) {
+        const char* own = m_adapters[i].mac;
+        size_t n = 0;
+        for (; n < mac.size() && own[n]; ++n) {
+            // Server format is XX-XX-XX-XX-XX-XX (matching the Node.js behavior)
+            char c = own[n] == ':' ? '-' : static_cast<char>(toupper(static_cast<unsigned char>(own[n])));
+            if (c != mac[n]) break;
         }
-        macs.push_back(mac);
+        if (n == mac.size() && own[n] == '\0') return true;
     }
-    return macs;
+    return false;
 }
@@ -1,19 +1,34 @@
 #pragma once
+#include <Windows.h>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
+#include "JsonWriter.h"
 
-struct AdapterInfo {
-    std::string mac;
-    std::string ipv4;
-    std::string ipv6;
-};
+// Snapshot of the local network adapters (IP Helper API), reused between
+// reports: the GetAdaptersAddresses buffer and the per-adapter strings keep
+// their capacity, so refreshing and serializing allocate nothing once warm.
+class AdapterSnapshot {
+public:
+    bool Refresh();
+
+    // Members adapter name -> {"mac","ipv4","ipv6"}, sorted by name, matching the
+    // Node.js macaddress.all() output format; the caller opens and closes the object
+    void WriteMembers(Json::Writer& writer) const;
 
-// Returns map of adapter name -> info, similar to Node macaddress.all()
-std::map<std::string, AdapterInfo> GetAllAdapters();
+    // True if a local adapter has this MAC in uppercase XX-XX-XX-XX-XX-XX format
+    bool HasMac(std::string_view mac) const;
 
-// Returns JSON string matching the Node.js macaddress.all() output format
-std::string GetAdaptersJson();
+private:
+    struct Adapter {
+        std::string name;  // Friendly name, UTF-8
+        char mac[24]{};    // aa:bb:cc:dd:ee:ff
+        char ipv4[16]{};   // Last IPv4 address, empty if none
+        char ipv6[46]{};   // Last IPv6 address, empty if none
+    };
 
-// Returns all local MAC addresses in XX-XX-XX-XX-XX-XX format (uppercase)
-std::vector<std::string> GetLocalMacAddresses();
+    std::vector<BYTE> m_buffer;
+    std::vector<Adapter> m_adapters; // Only the first m_count are valid; the rest keep capacity
+    std::vector<size_t> m_order;     // Indices sorted by name, duplicates removed
+    size_t m_count = 0;
+};
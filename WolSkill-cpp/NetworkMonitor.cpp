@@ -0,0 +1,61 @@
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <iphlpapi.h>
+#include <netioapi.h>
+#include "NetworkMonitor.h"
+#include "Log.h"
+
+#pragma comment(lib, "iphlpapi.lib")
+
+static HWND g_target = nullptr;
+static UINT g_msg = 0;
+static HANDLE g_interfaceHandle = nullptr;
+static HANDLE g_addressHandle = nullptr;
+static HANDLE g_routeHandle = nullptr;
+
+static void Notify(const char* source, MIB_NOTIFICATION_TYPE type) {
+    LOG_DEBUG("Network change: {} (type {})", source, type);
+    if (g_target) PostMessageW(g_target, g_msg, 0, 0);
+}
+
+static VOID NETIOAPI_API_ OnInterfaceChange(PVOID, PMIB_IPINTERFACE_ROW, MIB_NOTIFICATION_TYPE type) {
+    Notify("interface", type);
+}
+
+static VOID NETIOAPI_API_ OnAddressChange(PVOID, PMIB_UNICASTIPADDRESS_ROW, MIB_NOTIFICATION_TYPE type) {
+    Notify("address", type);
+}
+
+static VOID NETIOAPI_API_ OnRouteChange(PVOID, PMIB_IPFORWARD_ROW2 row, MIB_NOTIFICATION_TYPE type) {
+    // Only default routes matter for reaching the gateway (VPN up/down, Wi-Fi switch)
+    if (row && row->DestinationPrefix.PrefixLength != 0) return;
+    Notify("default route", type);
+}
+
+bool NetworkMonitor::Start(HWND hWnd, UINT msg) {
+    g_target = hWnd;
+    g_msg = msg;
+
+    bool ok = true;
+    if (NotifyIpInterfaceChange(AF_UNSPEC, OnInterfaceChange, nullptr, FALSE, &g_interfaceHandle) != NO_ERROR) {
+        LOG_WARN("NotifyIpInterfaceChange failed");
+        ok = false;
+    }
+    if (NotifyUnicastIpAddressChange(AF_UNSPEC, OnAddressChange, nullptr, FALSE, &g_addressHandle) != NO_ERROR) {
+        LOG_WARN("NotifyUnicastIpAddressChange failed");
+        ok = false;
+    }
+    if (NotifyRouteChange2(AF_UNSPEC, OnRouteChange, nullptr, FALSE, &g_routeHandle) != NO_ERROR) {
+        LOG_WARN("NotifyRouteChange2 failed");
+        ok = false;
+    }
+    return ok;
+}
+
+void NetworkMonitor::Stop() {
+    // CancelMibChangeNotify2 waits for in-flight callbacks to return
+    if (g_interfaceHandle) { CancelMibChangeNotify2(g_interfaceHandle); g_interfaceHandle = nullptr; }
+    if (g_addressHandle) { CancelMibChangeNotify2(g_addressHandle); g_addressHandle = nullptr; }
+    if (g_routeHandle) { CancelMibChangeNotify2(g_routeHandle); g_routeHandle = nullptr; }
+    g_target = nullptr;
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <Windows.h>
+
+// Subscribes to IP interface, unicast address and route changes and posts
+// `msg` to `hWnd` for each one. Callbacks arrive on a thread-pool thread and
+// come in bursts, so the window is expected to debounce them.
+namespace NetworkMonitor {
+    bool Start(HWND hWnd, UINT msg);
+    void Stop();
+}
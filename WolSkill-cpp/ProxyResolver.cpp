@@ -0,0 +1,240 @@
+#include "ProxyResolver.h"
+#include "Log.h"
+
+#pragma comment(lib, "winhttp.lib")
+
+// Bounds the WPAD lookups and the PAC download
+static constexpr int DISCOVERY_TIMEOUT_MS = 5000;
+
+static void FreeString(LPWSTR s) {
+    if (s) GlobalFree(s);
+}
+
+ProxyResolver::~ProxyResolver() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+        ReleaseSession();
+    }
+    m_refreshed.notify_all();
+    // A lookup in progress runs to its timeouts and closes its session
+    if (m_thread.joinable()) m_thread.join();
+}
+
+void ProxyResolver::Cancel() {
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_refreshing) m_cancelled = true;
+        ReleaseSession();
+    }
+    m_refreshed.notify_all();
+}
+
+// During a lookup the refresh thread may be about to pass the session to WinHTTP: closing it
+// here could hand that call a closed or reused handle, so the thread closes its own copy
+void ProxyResolver::ReleaseSession() {
+    if (m_session && !m_sessionInUse) WinHttpCloseHandle(m_session);
+    m_session = nullptr;
+}
+
+void ProxyResolver::SetOverride(const std::wstring& proxy) {
+    std::lock_guard lock(m_mutex);
+    if (proxy == m_override) return;
+    m_override = proxy;
+    ++m_generation;
+    m_valid = false;
+}
+
+void ProxyResolver::SetAutoConfigUrl(const std::wstring& url) {
+    std::lock_guard lock(m_mutex);
+    m_autoConfigUrl = url;
+    ++m_generation;
+}
+
+void ProxyResolver::Invalidate() {
+    std::lock_guard lock(m_mutex);
+    ++m_generation;
+    if (!m_valid) return;
+    m_stale = true;
+    StartRefresh();
+}
+
+bool ProxyResolver::Get(const wchar_t* url, const std::function<bool()>& stopped, Route& route, bool& cached) {
+    std::unique_lock lock(m_mutex);
+    m_url = url;
+
+    // A stale route may point at a proxy that is gone after a network change; the connect
+    // fails then, and the reconnect after it gets the refreshed route
+    if (m_valid) {
+        if (m_stale || GetTickCount64() - m_route.resolvedTick >= kRefreshAfterMs) StartRefresh();
+        route = m_route;
+        cached = true;
+        return true;
+    }
+
+    // Nothing to fall back on: wait for the first resolution, or a new override's
+    while (!m_valid) {
+        if (stopped() || m_stopping) return false;
+        StartRefresh();
+        m_refreshed.wait(lock, [&] { return !m_refreshing || m_valid || stopped() || m_stopping; });
+    }
+    route = m_route;
+    cached = false;
+    return true;
+}
+
+ProxyResolver::Route ProxyResolver::Current() const {
+    std::lock_guard lock(m_mutex);
+    return m_route;
+}
+
+const char* ProxyResolver::SourceName(Source source) {
+    switch (source) {
+    case Source::Override: return "override";
+    case Source::AutoConfig: return "autoconfig";
+    case Source::Manual: return "manual";
+    case Source::Machine: return "machine";
+    default: return "none";
+    }
+}
+
+void ProxyResolver::StartRefresh() {
+    if (m_refreshing || m_stopping || m_url.empty()) return;
+    // A finished refresh thread only has to return from RefreshThread
+    if (m_thread.joinable()) m_thread.join();
+    m_refreshing = true;
+    m_cancelled = false;
+    m_thread = std::thread(&ProxyResolver::RefreshThread, this);
+}
+
+void ProxyResolver::RefreshThread() {
+    std::unique_lock lock(m_mutex);
+    while (!m_stopping) {
+        unsigned generation = m_generation;
+        std::wstring url = m_url;
+        std::wstring override = m_override;
+        std::wstring autoConfigUrl = m_autoConfigUrl;
+        lock.unlock();
+        Route route = Resolve(url, override, autoConfigUrl);
+        lock.lock();
+        // Discovery was aborted part way, so the result may be a fallback source
+        if (m_cancelled) {
+            LOG_INFO("Proxy lookup cancelled after {} ms", route.resolveMs);
+            break;
+        }
+        // Another network change or a new override arrived meanwhile: resolve again
+        if (generation != m_generation) continue;
+        LOG_INFO("Proxy resolved in {} ms: {} ({})", route.resolveMs,
+            route.proxy.empty() ? "direct" : "via proxy", SourceName(route.source));
+        m_route = route;
+        m_valid = true;
+        m_stale = false;
+        break;
+    }
+    m_refreshing = false;
+    m_refreshed.notify_all();
+}
+
+// Refresh thread: the session for this lookup, kept for the next one unless released meanwhile
+HINTERNET ProxyResolver::Session() {
+    std::lock_guard lock(m_mutex);
+    if (!m_session && !m_stopping && !m_cancelled) {
+        m_session = WinHttpOpen(L"WolSkill/1.0", WINHTTP_ACCESS_TYPE_NO_PROXY, nullptr, nullptr, 0);
+        if (m_session)
+            WinHttpSetTimeouts(m_session, DISCOVERY_TIMEOUT_MS, DISCOVERY_TIMEOUT_MS,
+                DISCOVERY_TIMEOUT_MS, DISCOVERY_TIMEOUT_MS);
+    }
+    m_sessionInUse = m_session != nullptr;
+    return m_session;
+}
+
+void ProxyResolver::EndLookup(HINTERNET session) {
+    std::lock_guard lock(m_mutex);
+    m_sessionInUse = false;
+    if (session && session != m_session) WinHttpCloseHandle(session);
+}
+
+ProxyResolver::Route ProxyResolver::Resolve(const std::wstring& url, const std::wstring& override,
+    const std::wstring& autoConfigUrl) {
+    ULONGLONG start = GetTickCount64();
+    Route route;
+    if (!override.empty()) {
+        route.source = Source::Override;
+        if (_wcsicmp(override.c_str(), L"direct") != 0) route.proxy = override;
+    } else {
+        ResolveSystem(url, autoConfigUrl, route);
+    }
+    route.resolvedTick = GetTickCount64();
+    route.resolveMs = static_cast<ULONG>(route.resolvedTick - start);
+    return route;
+}
+
+void ProxyResolver::ResolveSystem(const std::wstring& url, const std::wstring& autoConfigUrl, Route& route) {
+    WINHTTP_CURRENT_USER_IE_PROXY_CONFIG user{};
+    bool haveUser = autoConfigUrl.empty() && WinHttpGetIEProxyConfigForCurrentUser(&user) != FALSE;
+
+    bool resolved = false;
+    if (!autoConfigUrl.empty() || (haveUser && (user.fAutoDetect || user.lpszAutoConfigUrl))) {
+        WINHTTP_AUTOPROXY_OPTIONS options{};
+        if (!autoConfigUrl.empty()) {
+            options.dwFlags |= WINHTTP_AUTOPROXY_CONFIG_URL;
+            options.lpszAutoConfigUrl = autoConfigUrl.c_str();
+        } else if (user.lpszAutoConfigUrl) {
+            options.dwFlags |= WINHTTP_AUTOPROXY_CONFIG_URL;
+            options.lpszAutoConfigUrl = user.lpszAutoConfigUrl;
+        }
+        if (user.fAutoDetect) {
+            options.dwFlags |= WINHTTP_AUTOPROXY_AUTO_DETECT;
+            options.dwAutoDetectFlags = WINHTTP_AUTO_DETECT_TYPE_DHCP | WINHTTP_AUTO_DETECT_TYPE_DNS_A;
+        }
+
+        WINHTTP_PROXY_INFO info{};
+        HINTERNET session = Session();
+        BOOL ok = session && WinHttpGetProxyForUrl(session, url.c_str(), &options, &info);
+        // The PAC server may require the logged-on user's credentials
+        if (!ok && session && GetLastError() == ERROR_WINHTTP_LOGIN_FAILURE) {
+            options.fAutoLogonIfChallenged = TRUE;
+            ok = WinHttpGetProxyForUrl(session, url.c_str(), &options, &info);
+        }
+        if (ok) {
+            route.source = Source::AutoConfig;
+            if (info.dwAccessType == WINHTTP_ACCESS_TYPE_NAMED_PROXY && info.lpszProxy) {
+                route.proxy = info.lpszProxy;
+                if (info.lpszProxyBypass) route.bypass = info.lpszProxyBypass;
+            }
+            FreeString(info.lpszProxy);
+            FreeString(info.lpszProxyBypass);
+            resolved = true;
+        } else if (GetLastError() == ERROR_WINHTTP_OPERATION_CANCELLED) {
+            LOG_DEBUG("Proxy auto-configuration cancelled");
+        } else {
+            LOG_WARN("Proxy auto-configuration failed: error {}", GetLastError());
+        }
+        EndLookup(session);
+    }
+
+    if (!resolved && haveUser && user.lpszProxy) {
+        route.source = Source::Manual;
+        route.proxy = user.lpszProxy;
+        if (user.lpszProxyBypass) route.bypass = user.lpszProxyBypass;
+        resolved = true;
+    }
+
+    // What WINHTTP_ACCESS_TYPE_DEFAULT_PROXY used before discovery was added
+    WINHTTP_PROXY_INFO machine{};
+    if (!resolved && WinHttpGetDefaultProxyConfiguration(&machine)) {
+        if (machine.dwAccessType == WINHTTP_ACCESS_TYPE_NAMED_PROXY && machine.lpszProxy) {
+            route.source = Source::Machine;
+            route.proxy = machine.lpszProxy;
+            if (machine.lpszProxyBypass) route.bypass = machine.lpszProxyBypass;
+        }
+        FreeString(machine.lpszProxy);
+        FreeString(machine.lpszProxyBypass);
+    }
+
+    if (haveUser) {
+        FreeString(user.lpszAutoConfigUrl);
+        FreeString(user.lpszProxy);
+        FreeString(user.lpszProxyBypass);
+    }
+}
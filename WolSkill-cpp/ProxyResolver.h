@@ -0,0 +1,86 @@
+#pragma once
+#include <Windows.h>
+#include <winhttp.h>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Proxy route to the gateway, resolved once and cached.
+//
+// WPAD/PAC discovery (DHCP and DNS lookups, downloading and running the
+// script) can take seconds, so it runs on a background thread and is kept
+// off the reconnect path: only the first lookup, with no route to fall back
+// on, waits for it, and that wait ends when the caller stops. Later lookups
+// return the last route at once; a network change, or a route older than
+// kRefreshAfterMs, starts a refresh that the next connection picks up.
+// Cancel() drops the result of a discovery in progress; the refresh thread
+// owns the session while it runs and closes it once its lookup returns.
+//
+// Order: the `Proxy` registry override ("direct" or host:port, e.g. a local
+// test proxy), then the user's auto-configuration (WPAD, PAC URL), the
+// user's manual proxy, and the machine WinHTTP proxy (netsh winhttp).
+class ProxyResolver {
+public:
+    enum class Source { None, Override, AutoConfig, Manual, Machine };
+
+    struct Route {
+        std::wstring proxy;  // WINHTTP_PROXY_INFO list; empty to connect directly
+        std::wstring bypass;
+        Source source = Source::None;
+        ULONGLONG resolvedTick = 0;
+        ULONG resolveMs = 0; // Time the resolution itself took
+    };
+
+    static constexpr ULONGLONG kRefreshAfterMs = 15 * 60 * 1000;
+
+    ProxyResolver() = default;
+    ~ProxyResolver();
+
+    ProxyResolver(const ProxyResolver&) = delete;
+    ProxyResolver& operator=(const ProxyResolver&) = delete;
+
+    // Registry override; empty for discovery. A change discards the cached route.
+    void SetOverride(const std::wstring& proxy);
+    // The network changed: resolve again in the background
+    void Invalidate();
+    // Test hook: discover from this PAC URL instead of the user's settings
+    void SetAutoConfigUrl(const std::wstring& url);
+
+    // Route for `url`; `cached` tells whether discovery was skipped. False if
+    // `stopped` turned true before the first route was resolved; Cancel()
+    // wakes a lookup waiting for it.
+    bool Get(const wchar_t* url, const std::function<bool()>& stopped, Route& route, bool& cached);
+    // Discards the discovery in progress; the session is reopened by the next one
+    void Cancel();
+    // Last resolved route, without resolving (status)
+    Route Current() const;
+
+    static const char* SourceName(Source source);
+
+private:
+    Route Resolve(const std::wstring& url, const std::wstring& override, const std::wstring& autoConfigUrl);
+    void ResolveSystem(const std::wstring& url, const std::wstring& autoConfigUrl, Route& route);
+    HINTERNET Session();
+    void EndLookup(HINTERNET session);
+    void StartRefresh(); // m_mutex held
+    void ReleaseSession(); // m_mutex held
+    void RefreshThread();
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_refreshed;
+    Route m_route;
+    bool m_valid = false;      // m_route holds a resolution for the current override
+    bool m_stale = false;      // The network changed since m_route was resolved
+    bool m_refreshing = false;
+    bool m_stopping = false;
+    bool m_cancelled = false;  // Cancel() since the running refresh started; its result is dropped
+    unsigned m_generation = 0; // Bumped by Invalidate/SetOverride; older results are dropped
+    std::wstring m_override;
+    std::wstring m_autoConfigUrl;
+    std::wstring m_url;        // Last URL looked up, refreshed after network changes
+    std::thread m_thread;
+    HINTERNET m_session = nullptr; // For WinHttpGetProxyForUrl, opened on first use; released by Cancel()
+    bool m_sessionInUse = false;   // Between Session() and EndLookup(): the refresh thread closes it
+};
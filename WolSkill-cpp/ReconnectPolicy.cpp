@@ -0,0 +1,9 @@
+#include "ReconnectPolicy.h"
+#include "ConnectionHealth.h"
+
+const char* ReconnectPolicy::HandoverReason(ULONGLONG now, int healthScore, ULONGLONG openedTick) const {
+    if (m_lastAttempt && now - m_lastAttempt < kHandoverRetryMs) return nullptr;
+    if (healthScore < ConnectionHealth::kDegradedScore) return "degraded";
+    if (openedTick && now - openedTick >= kRotateAfterMs) return "rotation";
+    return nullptr;
+}
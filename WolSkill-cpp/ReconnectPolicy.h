@@ -0,0 +1,25 @@
+#pragma once
+#include <Windows.h>
+
+// When the client reconnects, and when it replaces a connection that still works.
+//
+// WebSocketClient's worker and the --simulate model both take their delays and
+// handover decisions from here, so a simulated run exercises the shipped policy.
+// Not thread-safe; the owner serializes access.
+class ReconnectPolicy {
+public:
+    static constexpr DWORD kReconnectDelayMs = 5000; // After a lost or failed connection
+    static constexpr DWORD kNetworkDebounceMs = 300; // Bursts of network notifications settle first
+    // API Gateway closes connections after 2 hours; rotate well before that
+    static constexpr ULONGLONG kRotateAfterMs = 100 * 60 * 1000;
+    // Minimum spacing between handover attempts, so a bad network does not cause churn
+    static constexpr ULONGLONG kHandoverRetryMs = 60 * 1000;
+
+    // Checked after every report. Returns why the active connection, opened at openedTick,
+    // should be replaced ("degraded" or "rotation"), or nullptr.
+    const char* HandoverReason(ULONGLONG now, int healthScore, ULONGLONG openedTick) const;
+    void OnHandoverAttempt(ULONGLONG now) { m_lastAttempt = now; }
+
+private:
+    ULONGLONG m_lastAttempt = 0;
+};
@@ -1,4 +1,5 @@
 #include "Settings.h"
+#include "Log.h"
 #include <winrt/Windows.Foundation.h>
 #include <winrt/Windows.ApplicationModel.h>
 
@@ -22,6 +23,35 @@ bool Settings::Load() {
         license = buf;
     }
 
+    DWORD level = 0;
+    size = sizeof(level);
+    if (RegQueryValueExW(hKey, REG_VAL_LOGLEVEL, nullptr, nullptr,
+        reinterpret_cast<LPBYTE>(&level), &size) == ERROR_SUCCESS) {
+        logLevel = level;
+    }
+
+    DWORD scan = 0;
+    size = sizeof(scan);
+    if (RegQueryValueExW(hKey, REG_VAL_NEIGHBORSCAN, nullptr, nullptr,
+        reinterpret_cast<LPBYTE>(&scan), &size) == ERROR_SUCCESS) {
+        neighborScan = scan;
+    }
+
+    DWORD low = 0;
+    size = sizeof(low);
+    if (RegQueryValueExW(hKey, REG_VAL_LOWMEMORY, nullptr, nullptr,
+        reinterpret_cast<LPBYTE>(&low), &size) == ERROR_SUCCESS) {
+        lowMemory = low;
+    }
+
+    // Read on every load, so removing the value restores discovery on reload
+    proxy.clear();
+    size = sizeof(buf);
+    if (RegQueryValueExW(hKey, REG_VAL_PROXY, nullptr, nullptr,
+        reinterpret_cast<LPBYTE>(buf), &size) == ERROR_SUCCESS) {
+        proxy = buf;
+    }
+
     RegCloseKey(hKey);
     return true;
 }
@@ -49,10 +79,23 @@ bool Settings::IsValid() const {
     return !awsId.empty() && !license.empty();
 }
 
+// WinRT is only needed for the startup task, so the apartment is joined on first use
+// instead of at launch
+static void EnsureApartment() {
+    static bool initialized = false;
+    if (initialized) return;
+    winrt::init_apartment(winrt::apartment_type::multi_threaded);
+    initialized = true;
+}
+
 bool Settings::IsRunOnStartup() {
     try {
+        EnsureApartment();
         auto task = winrt::Windows::ApplicationModel::StartupTask::GetAsync(STARTUP_TASK_ID).get();
         return task.State() == winrt::Windows::ApplicationModel::StartupTaskState::Enabled;
+    } catch (const winrt::hresult_error& e) {
+        LOG_DEBUG("IsRunOnStartup: StartupTask unavailable, hr={}", Log::Hex{ static_cast<uint32_t>(e.code().value) });
+        return false;
     } catch (...) {
         return false;
     }
@@ -60,12 +103,16 @@ bool Settings::IsRunOnStartup() {
 
 void Settings::SetRunOnStartup(bool enable) {
     try {
+        EnsureApartment();
         auto task = winrt::Windows::ApplicationModel::StartupTask::GetAsync(STARTUP_TASK_ID).get();
         if (enable) {
             task.RequestEnableAsync().get();
         } else {
             task.Disable();
         }
+    } catch (const winrt::hresult_error& e) {
+        LOG_WARN("SetRunOnStartup({}) failed: hr={}", enable, Log::Hex{ static_cast<uint32_t>(e.code().value) });
     } catch (...) {
+        LOG_WARN("SetRunOnStartup({}) failed", enable);
     }
 }
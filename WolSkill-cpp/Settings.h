@@ -7,11 +7,19 @@ public:
     static constexpr const wchar_t* REG_KEY = L"SOFTWARE\\WolSkill";
     static constexpr const wchar_t* REG_VAL_AWSID = L"AwsId";
     static constexpr const wchar_t* REG_VAL_LICENSE = L"License";
+    static constexpr const wchar_t* REG_VAL_LOGLEVEL = L"LogLevel";
+    static constexpr const wchar_t* REG_VAL_NEIGHBORSCAN = L"NeighborScan";
+    static constexpr const wchar_t* REG_VAL_LOWMEMORY = L"LowMemory";
+    static constexpr const wchar_t* REG_VAL_PROXY = L"Proxy";
 
     static constexpr const wchar_t* STARTUP_TASK_ID = L"WolSkillStartup";
 
     std::wstring awsId;
     std::wstring license;
+    DWORD logLevel = 2; // Log::Level::Info; not exposed in the dialog
+    DWORD neighborScan = 0; // 0 = off, 1 = read the neighbor table, 2 = also sweep subnets
+    DWORD lowMemory = 0;    // 1 = defer UI modules, trim the working set, enforce the memory budget
+    std::wstring proxy;     // Empty = discover (WPAD/PAC, system settings), "direct" or host:port
 
     bool Load();
     bool Save() const;
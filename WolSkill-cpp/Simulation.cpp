@@ -0,0 +1,458 @@
+#include "Simulation.h"
+#include "ConnectionHealth.h"
+#include "ConnectionLifecycle.h"
+#include "HeartbeatScheduler.h"
+#include "ReconnectPolicy.h"
+#include <cstdio>
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Ms = ULONGLONG;
+using Timer = ConnectionLifecycle::Timer;
+
+constexpr Ms SECOND = 1000;
+constexpr Ms MINUTE = 60 * SECOND;
+constexpr Ms DAY = 24 * 60 * MINUTE;
+
+// The modelled transport; delays and handover decisions come from ReconnectPolicy
+constexpr Ms MIN_CONNECT_MS = 150;               // DNS + TCP + TLS + upgrade
+constexpr Ms MAX_CONNECT_MS = 1200;
+constexpr Ms TCP_SURVIVES_OUTAGE_MS = 20 * SECOND; // Shorter outages are ridden out by retransmits
+constexpr Ms MIN_SILENT_ERROR_MS = 2 * MINUTE;   // Until a half-open socket finally errors
+constexpr Ms MAX_SILENT_ERROR_MS = 15 * MINUTE;
+constexpr Ms SERVER_IDLE_TIMEOUT_MS = 10 * MINUTE;
+constexpr Ms SLOW_PATH_RTT_MS = 3 * SECOND;       // Added to every pong on a congested connection
+
+class Simulator : public ConnectionLifecycle::Clock, public ConnectionLifecycle::Transport {
+public:
+    Simulator(const Simulation::Scenario& scenario, uint64_t seed)
+        : m_scenario(scenario), m_rng(seed), m_scheduler(0), m_lifecycle(*this, *this, m_scheduler) {}
+
+    Simulation::Result Run(Ms duration) {
+        m_end = duration;
+        ScheduleEnvironment();
+        Connect();
+
+        while (!m_queue.empty() && m_queue.top().when <= m_end) {
+            Event e = m_queue.top();
+            m_queue.pop();
+            Advance(e.when);
+            e.action();
+        }
+        Advance(m_end);
+
+        m_result.availability = m_eligibleMs ? static_cast<double>(m_reachableMs) / m_eligibleMs : 1.0;
+        m_result.passed = m_result.maxUnreachableMs <= Simulation::kMaxUnreachableMs;
+        return m_result;
+    }
+
+    // ---------- ConnectionLifecycle::Clock ----------
+    ULONGLONG Now() override { return m_now; }
+
+    void Arm(Timer timer, ULONGLONG dueMs, ULONG toleranceMs) override {
+        // Coalescing may deliver the timer anywhere inside its tolerance window
+        uint64_t gen = ++m_timerGen[static_cast<int>(timer)];
+        Ms when = m_now + dueMs + (toleranceMs ? Uniform(0, toleranceMs) : 0);
+        AtMachine(when, [this, timer, gen] {
+            if (m_timerGen[static_cast<int>(timer)] != gen) return;
+            ++m_timerGen[static_cast<int>(timer)];
+            m_lifecycle.OnTimer(timer);
+        });
+    }
+
+    void Cancel(Timer timer) override { ++m_timerGen[static_cast<int>(timer)]; }
+
+    // ---------- ConnectionLifecycle::Transport ----------
+    void SendReport() override {
+        if (m_clientState != ClientState::Connected) return;
+        ++m_result.reports;
+        // WebSocketClient::Send(): the report is a health probe and may start a handover
+        m_health.OnProbeSent(m_now);
+        MaybeHandover();
+        if (!m_connAlive || !m_linkUp) return;
+
+        uint64_t conn = m_connGen;
+        m_lastReportAt = m_now;
+        AtMachine(m_now + SERVER_IDLE_TIMEOUT_MS, [this, conn] {
+            if (conn == m_connGen && m_connAlive && m_now - m_lastReportAt >= SERVER_IDLE_TIMEOUT_MS)
+                ServerClose();
+        });
+
+        if (Chance(m_scenario.pongLossRate)) return;
+        Ms rtt = Uniform(m_scenario.minRttMs, m_scenario.maxRttMs) + (m_connSlow ? SLOW_PATH_RTT_MS : 0);
+        AtMachine(m_now + rtt, [this, conn] {
+            if (conn != m_connGen || !m_connAlive || !m_linkUp) return;
+            ++m_result.pongs;
+            m_health.OnPong(m_now);
+            m_lifecycle.OnPong();
+        });
+    }
+
+    void Reconnect() override {
+        ++m_result.reconnectRequests;
+        if (m_clientState == ClientState::Connected) {
+            // Closing the handles makes the worker report Disconnected, then skip the backoff
+            ClientLost();
+        }
+        Connect();
+    }
+
+private:
+    enum class ClientState { Backoff, Connecting, Connected };
+
+    struct Event {
+        Ms when;
+        uint64_t seq;
+        std::function<void()> action;
+        bool operator>(const Event& o) const { return when != o.when ? when > o.when : seq > o.seq; }
+    };
+
+    // ---------- Event plumbing ----------
+    void At(Ms when, std::function<void()> action) {
+        m_queue.push({ when, m_seq++, std::move(action) });
+    }
+
+    // Events that happen on the machine are held back while it sleeps
+    void AtMachine(Ms when, std::function<void()> action) {
+        At(when, [this, action = std::move(action)]() mutable {
+            if (m_asleep) {
+                AtMachine(m_wakeAt, std::move(action));
+                return;
+            }
+            action();
+        });
+    }
+
+    Ms Uniform(Ms lo, Ms hi) {
+        return std::uniform_int_distribution<Ms>(lo, hi)(m_rng);
+    }
+
+    bool Chance(double p) {
+        return p > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(m_rng) < p;
+    }
+
+    // Next arrival of a Poisson process with the given daily rate
+    Ms NextArrival(double perDay) {
+        double mean = static_cast<double>(DAY) / perDay;
+        return m_now + static_cast<Ms>(std::exponential_distribution<double>(1.0 / mean)(m_rng)) + 1;
+    }
+
+    // ---------- Reachability accounting ----------
+    bool Eligible() const { return m_linkUp && !m_asleep; }
+    bool Reachable() const { return Eligible() && m_clientState == ClientState::Connected && m_connAlive; }
+
+    void Advance(Ms to) {
+        if (to > m_now) {
+            Ms span = to - m_now;
+            if (Eligible()) {
+                m_eligibleMs += span;
+                if (Reachable()) {
+                    m_reachableMs += span;
+                } else {
+                    m_unreachableRun += span;
+                    if (m_unreachableRun > m_result.maxUnreachableMs)
+                        m_result.maxUnreachableMs = m_unreachableRun;
+                }
+            }
+            m_now = to;
+        }
+        if (!Eligible() || Reachable()) m_unreachableRun = 0;
+    }
+
+    // ---------- Modelled WebSocketClient worker ----------
+    void Connect() {
+        uint64_t attempt = ++m_attemptGen;
+        m_clientState = ClientState::Connecting;
+        AtMachine(m_now + Uniform(MIN_CONNECT_MS, MAX_CONNECT_MS), [this, attempt] {
+            if (attempt != m_attemptGen || m_clientState != ClientState::Connecting) return;
+            if (!m_linkUp) {
+                m_lifecycle.OnDisconnected();
+                Backoff();
+                return;
+            }
+            ++m_connGen;
+            m_connAlive = true;
+            m_connSlow = false;
+            m_openedAt = m_now;
+            m_health.Reset();
+            m_clientState = ClientState::Connected;
+            ++m_result.connects;
+            m_lifecycle.OnConnected();
+        });
+    }
+
+    void Backoff() {
+        uint64_t attempt = ++m_attemptGen;
+        m_clientState = ClientState::Backoff;
+        AtMachine(m_now + ReconnectPolicy::kReconnectDelayMs, [this, attempt] {
+            if (attempt == m_attemptGen) Connect();
+        });
+    }
+
+    // The client's receive failed or its handles were closed. Closing the handles also
+    // ends a handover attempt.
+    void ClientLost() {
+        ++m_connGen;
+        m_connAlive = false;
+        m_clientState = ClientState::Backoff;
+        ++m_attemptGen;
+        ++m_handoverGen;
+        m_handoverRunning = false;
+        m_lostDuringHandover = false;
+        m_lifecycle.OnDisconnected();
+    }
+
+    // The worker's receive failed: during a handover it waits for the standby instead
+    void ActiveLost() {
+        if (m_handoverRunning) {
+            m_connAlive = false;
+            m_lostDuringHandover = true;
+            return;
+        }
+        ClientLost();
+        Backoff();
+    }
+
+    // Server closed the socket: the client sees it at once
+    void ServerClose() {
+        if (m_clientState != ClientState::Connected) return;
+        ++m_result.drops;
+        ActiveLost();
+    }
+
+    // The connection stops carrying data without any error on the client
+    void SilentDeath() {
+        if (m_clientState != ClientState::Connected || !m_connAlive) return;
+        ++m_result.drops;
+        m_connAlive = false;
+        uint64_t conn = m_connGen;
+        AtMachine(m_now + Uniform(MIN_SILENT_ERROR_MS, MAX_SILENT_ERROR_MS), [this, conn] {
+            if (conn != m_connGen || m_clientState != ClientState::Connected) return;
+            ActiveLost();
+        });
+    }
+
+    // ---------- Modelled make-before-break handover ----------
+    void MaybeHandover() {
+        const char* reason = m_policy.HandoverReason(m_now, m_health.Score(), m_openedAt);
+        if (!reason || m_handoverRunning) return;
+        m_policy.OnHandoverAttempt(m_now);
+        m_handoverRunning = true;
+        ++m_result.handoverAttempts;
+
+        // A standby is opened on a fresh path and confirmed by the pong to a replayed report
+        uint64_t attempt = ++m_handoverGen;
+        uint64_t replacing = m_connGen;
+        AtMachine(m_now + Uniform(MIN_CONNECT_MS, MAX_CONNECT_MS), [this, attempt, replacing] {
+            if (attempt != m_handoverGen) return;
+            Ms rtt = Uniform(m_scenario.minRttMs, m_scenario.maxRttMs);
+            if (!m_linkUp || replacing != m_connGen) {
+                FinishHandover(false);
+            } else if (Chance(m_scenario.pongLossRate) || rtt >= ConnectionHealth::kPongTimeoutMs) {
+                AtMachine(m_now + ConnectionHealth::kPongTimeoutMs, [this, attempt] {
+                    if (attempt == m_handoverGen) FinishHandover(false);
+                });
+            } else {
+                AtMachine(m_now + rtt, [this, attempt, replacing] {
+                    if (attempt == m_handoverGen)
+                        FinishHandover(m_linkUp && replacing == m_connGen);
+                });
+            }
+        });
+    }
+
+    // A confirmed standby replaces the active connection without the lifecycle noticing
+    void FinishHandover(bool confirmed) {
+        bool lost = m_lostDuringHandover;
+        m_handoverRunning = false;
+        m_lostDuringHandover = false;
+        if (confirmed) {
+            ++m_connGen;
+            m_connAlive = true;
+            m_connSlow = false;
+            m_openedAt = m_now;
+            m_health.Reset();
+            ++m_result.handovers;
+        } else if (lost) {
+            ClientLost();
+            Backoff();
+        }
+    }
+
+    // NetworkMonitor notification followed by the window's debounce timer
+    void NetworkEvent() {
+        if (m_asleep) return;
+        m_lifecycle.OnNetworkEvent();
+        uint64_t gen = ++m_netGen;
+        AtMachine(m_now + ReconnectPolicy::kNetworkDebounceMs, [this, gen] {
+            if (gen == m_netGen) m_lifecycle.OnNetworkSettled();
+        });
+    }
+
+    // ---------- Environment ----------
+    void ScheduleEnvironment() {
+        if (m_scenario.outagesPerDay > 0) ScheduleOutage();
+        if (m_scenario.networkSwitchesPerDay > 0) ScheduleSwitch();
+        if (m_scenario.serverDropsPerDay > 0) ScheduleServerDrop();
+        if (m_scenario.silentDropsPerDay > 0) ScheduleSilentDrop();
+        if (m_scenario.sleepsPerDay > 0) ScheduleSleep();
+        if (m_scenario.slowPathsPerDay > 0) ScheduleSlowPath();
+    }
+
+    void ScheduleOutage() {
+        At(NextArrival(m_scenario.outagesPerDay), [this] {
+            if (m_linkUp && !m_asleep) {
+                Ms length = Uniform(SECOND, m_scenario.maxOutageMs);
+                m_linkUp = false;
+                if (length > TCP_SURVIVES_OUTAGE_MS) SilentDeath();
+                NetworkEvent();
+                At(m_now + length, [this] {
+                    m_linkUp = true;
+                    NetworkEvent();
+                });
+            }
+            ScheduleOutage();
+        });
+    }
+
+    void ScheduleSwitch() {
+        At(NextArrival(m_scenario.networkSwitchesPerDay), [this] {
+            if (m_linkUp && !m_asleep) {
+                m_linkUp = false;
+                SilentDeath();
+                NetworkEvent();
+                At(m_now + Uniform(500, 3 * SECOND), [this] {
+                    m_linkUp = true;
+                    NetworkEvent();
+                });
+            }
+            ScheduleSwitch();
+        });
+    }
+
+    void ScheduleServerDrop() {
+        At(NextArrival(m_scenario.serverDropsPerDay), [this] {
+            if (!m_asleep && m_connAlive) ServerClose();
+            ScheduleServerDrop();
+        });
+    }
+
+    void ScheduleSilentDrop() {
+        At(NextArrival(m_scenario.silentDropsPerDay), [this] {
+            if (!m_asleep) SilentDeath();
+            ScheduleSilentDrop();
+        });
+    }
+
+    // The active connection's route becomes congested; a new connection gets a fresh one
+    void ScheduleSlowPath() {
+        At(NextArrival(m_scenario.slowPathsPerDay), [this] {
+            if (!m_asleep && m_connAlive) m_connSlow = true;
+            ScheduleSlowPath();
+        });
+    }
+
+    void ScheduleSleep() {
+        At(NextArrival(m_scenario.sleepsPerDay), [this] {
+            if (!m_asleep) {
+                m_asleep = true;
+                m_wakeAt = m_now + Uniform(MINUTE, m_scenario.maxSleepMs);
+                SilentDeath();
+                At(m_wakeAt, [this] {
+                    m_asleep = false;
+                    m_lifecycle.OnResume();
+                    // The network comes back a moment after the machine does
+                    m_linkUp = false;
+                    At(m_now + Uniform(200, 4 * SECOND), [this] {
+                        m_linkUp = true;
+                        NetworkEvent();
+                    });
+                });
+            }
+            ScheduleSleep();
+        });
+    }
+
+    const Simulation::Scenario& m_scenario;
+    std::mt19937_64 m_rng;
+    HeartbeatScheduler m_scheduler;
+    ConnectionLifecycle m_lifecycle;
+    ConnectionHealth m_health;
+    ReconnectPolicy m_policy;
+
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> m_queue;
+    uint64_t m_seq = 0;
+    Ms m_now = 0;
+    Ms m_end = 0;
+
+    uint64_t m_timerGen[static_cast<int>(Timer::Count)]{};
+    uint64_t m_attemptGen = 0;
+    uint64_t m_connGen = 0;
+    uint64_t m_netGen = 0;
+    uint64_t m_handoverGen = 0;
+
+    ClientState m_clientState = ClientState::Backoff;
+    bool m_connAlive = false;
+    bool m_connSlow = false;
+    Ms m_openedAt = 0;
+    bool m_handoverRunning = false;
+    bool m_lostDuringHandover = false;
+    bool m_linkUp = true;
+    bool m_asleep = false;
+    Ms m_wakeAt = 0;
+    Ms m_lastReportAt = 0;
+
+    Ms m_eligibleMs = 0;
+    Ms m_reachableMs = 0;
+    Ms m_unreachableRun = 0;
+    Simulation::Result m_result;
+};
+
+const Simulation::Scenario SCENARIOS[] = {
+    // name           outages  maxOutage     switch  srvDrop silent pongLoss minRtt maxRtt  sleeps maxSleep       slow
+    { "steady",         0.0,  0,             0.0,    0.0,    0.0,  0.0,     40,    250,    0.0,  0,             0.0 },
+    { "lossy",          0.0,  0,             0.0,    0.0,    0.0,  0.02,    40,    2500,   0.0,  0,             0.0 },
+    { "flaky-wifi",    24.0,  90 * SECOND,  12.0,    0.0,    2.0,  0.005,   40,    600,    0.0,  0,             0.0 },
+    { "server-drops",   0.0,  0,             0.0,   24.0,    6.0,  0.0,     40,    400,    0.0,  0,             0.0 },
+    { "laptop",         4.0,  30 * SECOND,   6.0,    2.0,    2.0,  0.005,   40,    600,    4.0,  120 * MINUTE,  0.0 },
+    { "congested",      0.0,  0,             0.0,    0.0,    0.0,  0.0,     40,    400,    0.0,  0,            24.0 },
+    { "handover-drops", 0.0,  0,             0.0,   12.0,   12.0,  0.01,    40,    1500,   0.0,  0,            12.0 },
+};
+
+} // namespace
+
+Simulation::Result Simulation::Run(const Scenario& scenario, uint64_t seed, double days) {
+    Simulator sim(scenario, seed);
+    return sim.Run(static_cast<ULONGLONG>(days * DAY));
+}
+
+int Simulation::RunAll(uint64_t seed, double days) {
+    std::printf("Connection lifecycle simulation: seed %llu, %.1f days per scenario, limit %llu s unreachable\n\n",
+        static_cast<unsigned long long>(seed), days, kMaxUnreachableMs / SECOND);
+    std::printf("%-14s %10s %12s %9s %9s %9s %9s %7s %9s  %s\n",
+        "scenario", "avail %", "max unreach", "connects", "reconn", "reports", "pongs", "drops", "handover",
+        "result");
+
+    int failures = 0;
+    for (const auto& scenario : SCENARIOS) {
+        ULONGLONG start = GetTickCount64();
+        Result r = Run(scenario, seed, days);
+        ULONGLONG elapsed = GetTickCount64() - start;
+        if (!r.passed) ++failures;
+        std::printf("%-14s %10.4f %10.1f s %9llu %9llu %9llu %9llu %7llu %4llu/%-4llu  %s (%llu ms)\n",
+            scenario.name, r.availability * 100.0, r.maxUnreachableMs / 1000.0,
+            static_cast<unsigned long long>(r.connects),
+            static_cast<unsigned long long>(r.reconnectRequests),
+            static_cast<unsigned long long>(r.reports),
+            static_cast<unsigned long long>(r.pongs),
+            static_cast<unsigned long long>(r.drops),
+            static_cast<unsigned long long>(r.handovers),
+            static_cast<unsigned long long>(r.handoverAttempts),
+            r.passed ? "ok" : "FAIL", elapsed);
+    }
+    return failures ? 1 : 0;
+}
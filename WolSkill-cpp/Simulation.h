@@ -0,0 +1,50 @@
+#pragma once
+#include <Windows.h>
+#include <cstdint>
+
+// Deterministic simulation of the connection lifecycle.
+//
+// ConnectionLifecycle runs against a virtual clock and a modelled transport
+// (connect latency, pong RTT and loss, clean and silent drops, link outages,
+// network switches, sleep/resume, congested paths). Backoff, debounce and
+// handover decisions come from the client's own ReconnectPolicy and
+// ConnectionHealth. Days of operation take milliseconds and a seed reproduces
+// a run exactly. Started with `WolSkill-cpp.exe --simulate [seed] [days]`.
+namespace Simulation {
+    struct Scenario {
+        const char* name;
+        double outagesPerDay;          // Link down, interfaces change
+        ULONGLONG maxOutageMs;
+        double networkSwitchesPerDay;  // Wi-Fi/VPN switch: old path dies, new one comes up
+        double serverDropsPerDay;      // Clean close, seen by the client at once
+        double silentDropsPerDay;      // Half-open connection: no error, nothing arrives
+        double pongLossRate;
+        ULONGLONG minRttMs;
+        ULONGLONG maxRttMs;
+        double sleepsPerDay;
+        ULONGLONG maxSleepMs;
+        double slowPathsPerDay;        // The active connection's route congests until it is replaced
+    };
+
+    struct Result {
+        double availability = 0.0;      // Reachable share of the time the link was up and awake
+        ULONGLONG maxUnreachableMs = 0; // Longest unreachable stretch while the link was up and awake
+        uint64_t connects = 0;
+        uint64_t reconnectRequests = 0;
+        uint64_t reports = 0;
+        uint64_t pongs = 0;
+        uint64_t drops = 0;
+        uint64_t handovers = 0;         // Confirmed standby connections that replaced the active one
+        uint64_t handoverAttempts = 0;
+        bool passed = false;
+    };
+
+    // Invariant checked by every run: commands can always be delivered again within this
+    static constexpr ULONGLONG kMaxUnreachableMs = 60 * 1000;
+
+    Result Run(const Scenario& scenario, uint64_t seed, double days);
+
+    // Runs every built-in scenario and prints a table to stdout. Returns the process exit
+    // code: 0 if all invariants held.
+    int RunAll(uint64_t seed, double days);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <Windows.h>
+#include <cstdint>
+
+// UTF-8 validation of inbound text frames (RFC 6455 section 8.1), done in
+// the receive buffer while the frame is still in cache, before it is
+// appended to the message.
+//
+// Blocks of pure ASCII, which is all this protocol sends in practice, are
+// checked 16 (SSE2, NEON) or 32 (AVX2) bytes at a time; from the first
+// non-ASCII byte, only that run goes through the scalar state machine. The
+// state carries across calls, so a code point may span frame fragments. The
+// kernel is chosen once from the CPU features.
+namespace Utf8 {
+    enum class Kernel { Scalar, Sse2, Avx2, Neon, Count };
+
+    // Validation state between fragments of one message
+    struct State {
+        uint8_t need = 0;   // Continuation bytes still expected
+        uint8_t lo = 0x80;  // Allowed range of the next continuation byte
+        uint8_t hi = 0xBF;
+        bool Complete() const { return need == 0; }
+    };
+
+    // Validates `size` bytes, continuing from `state`. Returns false at the
+    // first invalid byte.
+    bool Validate(const BYTE* src, size_t size, State& state);
+    bool Validate(Kernel kernel, const BYTE* src, size_t size, State& state);
+
+    Kernel ActiveKernel();
+    bool IsSupported(Kernel kernel);
+    const char* KernelName(Kernel kernel);
+
+    // Throughput of every supported kernel on ASCII and mixed text, printed
+    // to stdout (`WolSkill-cpp.exe --bench-utf8 [MiB]`). Returns the exit code.
+    int RunBenchmark(size_t mib);
+}
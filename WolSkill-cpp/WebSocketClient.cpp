@@ -1,137 +1,961 @@
 #include "WebSocketClient.h"
+#include "Log.h"
+#include "Utf8Validator.h"
+#include <winsock2.h>
+#include <mstcpip.h>
 #include <vector>
+#include <cstdio>
 
 #pragma comment(lib, "winhttp.lib")
+#pragma comment(lib, "ws2_32.lib")
 
 static constexpr const wchar_t* WS_HOST = L"3rbp1kul8g.execute-api.eu-west-1.amazonaws.com";
 static constexpr INTERNET_PORT WS_PORT = INTERNET_DEFAULT_HTTPS_PORT;
+// What proxy discovery and PAC scripts see; the path carries the license, so it is left out
+static constexpr const wchar_t* PROXY_LOOKUP_URL = L"https://3rbp1kul8g.execute-api.eu-west-1.amazonaws.com/";
 
-WebSocketClient::WebSocketClient() = default;
+// Per-stage WinHTTP limits; the worst case for Disconnect() is the largest of these
+static constexpr int RESOLVE_TIMEOUT_MS = 5000;
+static constexpr int CONNECT_TIMEOUT_MS = 5000;
+static constexpr int SEND_TIMEOUT_MS = 5000;
+static constexpr int RECEIVE_TIMEOUT_MS = 10000;
+static constexpr DWORD DISCONNECT_TIMEOUT_MS = 1000;
+// Part of it kept for the work after the waits (closing handles, the state callback)
+static constexpr DWORD DISCONNECT_SLACK_MS = 50;
+
+// Transport keepalive, independent of the report interval. WinHTTP sends an unsolicited pong
+// frame at this interval (15 s is its minimum); TCP keepalive then probes an idle socket after
+// 10 s and Windows gives up after 10 unanswered probes 1 s apart, so a dead path fails the
+// pending receive after about 20 s instead of waiting for the application heartbeat timeout
+static constexpr DWORD WS_KEEPALIVE_INTERVAL_MS = 15000;
+static constexpr ULONG TCP_KEEPALIVE_TIME_MS = 10000;
+static constexpr ULONG TCP_KEEPALIVE_INTERVAL_MS = 1000;
+
+
+WebSocketClient::WebSocketClient()
+    : m_wakeEvent(CreateEventW(nullptr, FALSE, FALSE, nullptr)), m_host(WS_HOST), m_port(WS_PORT),
+      m_handoverEvent(CreateEventW(nullptr, FALSE, FALSE, nullptr)) {
+}
 
 WebSocketClient::~WebSocketClient() {
     Disconnect();
+    // The only unbounded wait: nothing the worker uses may be destroyed under it
+    if (m_abandoned.joinable()) m_abandoned.join();
+    if (m_session) WinHttpCloseHandle(m_session);
+    if (m_wakeEvent) CloseHandle(m_wakeEvent);
+    if (m_handoverEvent) CloseHandle(m_handoverEvent);
 }
 
 void WebSocketClient::SetCallbacks(MessageCallback onMsg, StateCallback onState) {
+    std::lock_guard lock(m_callbackMutex);
     m_onMessage = std::move(onMsg);
     m_onStateChange = std::move(onState);
 }
 
+void WebSocketClient::NotifyState(State state) {
+    std::lock_guard lock(m_callbackMutex);
+    if (m_onStateChange) m_onStateChange(state);
+}
+
 void WebSocketClient::Connect(const std::wstring& awsId, const std::wstring& license) {
     Disconnect();
-    m_shouldStop = false;
-    m_thread = std::thread(&WebSocketClient::WorkerThread, this, awsId, license);
+    // Build path with query params
+    std::wstring path = L"/prod?awsid=" + awsId + L"&license=" + license;
+    // The handler thread gets its own copy, so a handler that outlives Disconnect() holds no
+    // lock and nothing of the client; SetCallbacks() applies from the next Connect()
+    MessageCallback onMessage;
+    {
+        std::lock_guard lock(m_callbackMutex);
+        onMessage = m_onMessage;
+    }
+    m_dispatcher.Start(std::move(onMessage));
+    uint64_t run;
+    {
+        std::lock_guard lock(m_handleMutex);
+        run = ++m_runId;
+    }
+    m_thread = std::thread(&WebSocketClient::WorkerThread, this, std::move(m_abandoned), run, std::move(path));
 }
 
+// Returns within DISCONNECT_TIMEOUT_MS whatever the network or the message handler does
 void WebSocketClient::Disconnect() {
-    m_shouldStop = true;
-    if (m_hWebSocket) {
-        WinHttpWebSocketClose(m_hWebSocket, WINHTTP_WEB_SOCKET_SUCCESS_CLOSE_STATUS, nullptr, 0);
+    ULONGLONG start = GetTickCount64();
+    ULONGLONG deadline = start + DISCONNECT_TIMEOUT_MS - DISCONNECT_SLACK_MS;
+    auto remaining = [deadline] {
+        ULONGLONG now = GetTickCount64();
+        return static_cast<DWORD>(now < deadline ? deadline - now : 0);
+    };
+    {
+        std::lock_guard lock(m_handleMutex);
+        m_shouldStop = true;
+        m_stoppedRun = m_runId;
+    }
+    if (m_wakeEvent) SetEvent(m_wakeEvent);
+    if (m_handoverEvent) SetEvent(m_handoverEvent);
+    {
+        std::lock_guard lock(m_handoverMutex); // Not lost between the check and the wait
     }
-    if (m_thread.joinable())
-        m_thread.join();
+    m_handoverDone.notify_all();
+    // Drops the queued commands and releases a receive thread held by dispatcher backpressure
+    m_dispatcher.RequestStop();
+
+    // Abort whichever blocking call the worker or the handover is in (proxy lookup, resolve,
+    // connect, TLS, upgrade or receive). No close handshake: WinHttpWebSocketClose would wait on
+    // the very network that may be stalled, and the gateway treats the dropped socket as a
+    // disconnect. The worker joins the handover thread itself before it returns.
+    m_proxy.Cancel();
+    CloseHandles();
+
+    if (m_thread.joinable()) {
+        // The worker holds no lock across blocking calls, so it returns as soon as its handle
+        // is closed. A call that does not return in time anyway is not waited for here: the
+        // worker is left to finish once the WinHTTP timeouts fire.
+        if (WaitForSingleObject(m_thread.native_handle(), remaining()) == WAIT_TIMEOUT) {
+            LOG_ERROR("Worker did not stop within {} ms, leaving it to finish", DISCONNECT_TIMEOUT_MS);
+            m_abandoned = std::move(m_thread);
+        } else {
+            m_thread.join();
+        }
+    }
+    // The rest of the budget goes to the handler in progress (a shutdown, an adapter scan)
+    m_dispatcher.Stop(remaining());
     CloseHandles();
     m_state = State::Disconnected;
-    if (m_onStateChange) m_onStateChange(State::Disconnected);
+    LOG_DEBUG("Disconnect took {} ms", GetTickCount64() - start);
+    NotifyState(State::Disconnected);
+}
+
+void WebSocketClient::Reconnect() {
+    if (!m_thread.joinable()) return;
+    LOG_INFO("Reconnect requested in state {}", m_state.load());
+    // Closing the handles also abandons a connect attempt stuck on the old network path
+    CloseHandles();
+    if (m_wakeEvent) SetEvent(m_wakeEvent);
 }
 
+// Every outbound message is a report that the server answers with a pong, so each
+// send doubles as a health probe for the active connection
 void WebSocketClient::Send(const std::string& data) {
-    std::lock_guard lock(m_sendMutex);
-    if (m_hWebSocket && m_state == State::Connected) {
-        WinHttpWebSocketSend(m_hWebSocket,
-            WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE,
-            const_cast<void*>(static_cast<const void*>(data.c_str())),
-            static_cast<DWORD>(data.size()));
+    std::lock_guard sendLock(m_sendMutex);
+    HINTERNET hWebSocket;
+    {
+        std::lock_guard lock(m_handleMutex);
+        hWebSocket = m_active.hWebSocket;
+        if (!hWebSocket || m_state != State::Connected) return;
+        m_sendingOn = hWebSocket;
     }
+
+    // Not holding m_handleMutex across the send; CloseHandles() defers closing this
+    // handle until the send returns, so a swapped-out handle is never used after its close
+    DWORD err = WinHttpWebSocketSend(hWebSocket,
+        WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE,
+        const_cast<void*>(static_cast<const void*>(data.c_str())),
+        static_cast<DWORD>(data.size()));
+    {
+        std::lock_guard lock(m_handleMutex);
+        m_sendingOn = nullptr;
+        if (m_closeAfterSend) {
+            WinHttpCloseHandle(m_closeAfterSend);
+            m_closeAfterSend = nullptr;
+        }
+    }
+    if (err != NO_ERROR) {
+        LOG_WARN("WinHttpWebSocketSend failed: error {}", err);
+        return;
+    }
+    LOG_TRACE("send frame: {} bytes", data.size());
+
+    ULONGLONG now = GetTickCount64();
+    {
+        std::lock_guard lock(m_healthMutex);
+        m_health.OnProbeSent(now);
+    }
+    MaybeRequestHandover(now, data);
+}
+
+// Round trip time as measured by the TCP stack from ACKs, i.e. without the server's
+// JSON handling. Not blocking, so the handle lock can be held.
+bool WebSocketClient::GetTransportStats(TransportStats& stats) {
+    std::lock_guard lock(m_handleMutex);
+    if (!m_active.hRequest) return false;
+
+    TCP_INFO_v0 info{};
+    DWORD size = sizeof(info);
+    if (!WinHttpQueryOption(m_active.hRequest, WINHTTP_OPTION_CONNECTION_STATS_V0, &info, &size))
+        return false;
+    stats.rttUs = info.RttUs;
+    stats.minRttUs = info.MinRttUs;
+    stats.bytesRetransmitted = info.BytesRetrans;
+    stats.timeoutEpisodes = info.TimeoutEpisodes;
+    return true;
+}
+
+int WebSocketClient::GetHealthScore() const {
+    std::lock_guard lock(m_healthMutex);
+    return m_health.Score();
+}
+
+bool WebSocketClient::IsControlMessage(const std::string& msg) {
+    return msg.size() <= 64 && msg.find("\"pong\"") != std::string::npos;
+}
+
+HINTERNET WebSocketClient::ActiveWebSocket() {
+    std::lock_guard lock(m_handleMutex);
+    return m_active.hWebSocket;
+}
+
+// Appends a received frame to the message being assembled. Text is validated in the receive
+// buffer first (RFC 6455 section 8.1) and then appended, so the message is written once and
+// never zero-filled; false means the message is not UTF-8, and the connection is dropped like
+// any other protocol error. `state` carries a code point split across fragments.
+static bool AppendFrame(std::string& message, const BYTE* data, DWORD size,
+    WINHTTP_WEB_SOCKET_BUFFER_TYPE type, Utf8::State& state) {
+    if (type != WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE &&
+        type != WINHTTP_WEB_SOCKET_UTF8_FRAGMENT_BUFFER_TYPE) {
+        message.append(reinterpret_cast<const char*>(data), size);
+        return true;
+    }
+
+    size_t total = message.size() + size;
+    bool valid = Utf8::Validate(data, size, state);
+    if (valid) message.append(reinterpret_cast<const char*>(data), size);
+    if (type == WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE) {
+        valid = valid && state.Complete();
+        state = {};
+    }
+    if (!valid) LOG_WARN("Invalid UTF-8 in text message ({} bytes so far)", total);
+    return valid;
+}
+
+static void CloseConnectionHandles(HINTERNET& hWebSocket, HINTERNET& hRequest, HINTERNET& hConnect) {
+    if (hWebSocket) { WinHttpCloseHandle(hWebSocket); hWebSocket = nullptr; }
+    if (hRequest) { WinHttpCloseHandle(hRequest); hRequest = nullptr; }
+    if (hConnect) { WinHttpCloseHandle(hConnect); hConnect = nullptr; }
+}
+
+void WebSocketClient::CloseHandles(Connection& conn) {
+    std::lock_guard lock(m_handleMutex);
+    if (conn.hWebSocket && conn.hWebSocket == m_sendingOn) {
+        // Send() closes it on return; its value must not be reused before the send starts
+        m_closeAfterSend = conn.hWebSocket;
+        conn.hWebSocket = nullptr;
+    }
+    CloseConnectionHandles(conn.hWebSocket, conn.hRequest, conn.hConnect);
 }
 
 void WebSocketClient::CloseHandles() {
-    std::lock_guard lock(m_sendMutex);
-    if (m_hWebSocket) { WinHttpCloseHandle(m_hWebSocket); m_hWebSocket = nullptr; }
-    if (m_hRequest) { WinHttpCloseHandle(m_hRequest); m_hRequest = nullptr; }
-    if (m_hConnect) { WinHttpCloseHandle(m_hConnect); m_hConnect = nullptr; }
-    if (m_hSession) { WinHttpCloseHandle(m_hSession); m_hSession = nullptr; }
+    CloseHandles(m_active);
+    CloseHandles(m_standby);
+}
+
+// Opened on first connect and kept until the client is destroyed
+HINTERNET WebSocketClient::Session() {
+    std::lock_guard lock(m_handleMutex);
+    if (m_session) return m_session;
+
+    // Direct by default; a proxy is set on each request from the resolved route
+    m_session = WinHttpOpen(L"WolSkill/1.0", WINHTTP_ACCESS_TYPE_NO_PROXY, nullptr, nullptr, 0);
+    if (!m_session) return nullptr;
+
+    // Bound every handshake stage, so a stalled network cannot hold the worker indefinitely
+    WinHttpSetTimeouts(m_session, RESOLVE_TIMEOUT_MS, CONNECT_TIMEOUT_MS,
+        SEND_TIMEOUT_MS, RECEIVE_TIMEOUT_MS);
+
+    // Enable TLS 1.2+
+    DWORD protocols = WINHTTP_FLAG_SECURE_PROTOCOL_TLS1_2 | WINHTTP_FLAG_SECURE_PROTOCOL_TLS1_3;
+    WinHttpSetOption(m_session, WINHTTP_OPTION_SECURE_PROTOCOLS, &protocols, sizeof(protocols));
+
+    DWORD keepAlive = WS_KEEPALIVE_INTERVAL_MS;
+    if (!WinHttpSetOption(m_session, WINHTTP_OPTION_WEB_SOCKET_KEEPALIVE_INTERVAL, &keepAlive, sizeof(keepAlive)))
+        LOG_DEBUG("WebSocket keepalive interval not set: error {}", GetLastError());
+    // Windows 10 2004+; older systems keep the system TCP keepalive defaults (2 hours)
+    tcp_keepalive tcpKeepAlive{ 1, TCP_KEEPALIVE_TIME_MS, TCP_KEEPALIVE_INTERVAL_MS };
+    if (!WinHttpSetOption(m_session, WINHTTP_OPTION_TCP_KEEPALIVE, &tcpKeepAlive, sizeof(tcpKeepAlive)))
+        LOG_DEBUG("TCP keepalive not set: error {}", GetLastError());
+    return m_session;
+}
+
+WebSocketClient::ConnectTimings WebSocketClient::GetConnectTimings() {
+    std::lock_guard lock(m_handleMutex);
+    return m_lastConnect;
 }
 
-void WebSocketClient::WorkerThread(std::wstring awsId, std::wstring license) {
+static ULONG ElapsedUs(const LARGE_INTEGER& from, const LARGE_INTEGER& to) {
+    static const LONGLONG freq = [] {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        return f.QuadPart;
+    }();
+    return static_cast<ULONG>((to.QuadPart - from.QuadPart) * 1000000 / freq);
+}
+
+// Marks the end of the TCP connect to the first hop (the proxy, or the gateway when direct);
+// synchronous requests call back on the thread that sends them
+static void CALLBACK OnHandshakeStatus(HINTERNET, DWORD_PTR context, DWORD status, LPVOID, DWORD) {
+    if (status == WINHTTP_CALLBACK_STATUS_CONNECTED_TO_SERVER && context)
+        QueryPerformanceCounter(reinterpret_cast<LARGE_INTEGER*>(context));
+}
+
+// Store a freshly created handle so that CloseHandles() can cancel calls on it.
+// Returns false (and closes the handle) if a stop was requested meanwhile, or, for a
+// standby, if the connection it replaces is no longer the active one.
+bool WebSocketClient::Publish(HINTERNET& slot, HINTERNET handle, HINTERNET replacing) {
+    std::lock_guard lock(m_handleMutex);
+    if (m_shouldStop || (replacing && m_active.hWebSocket != replacing)) {
+        WinHttpCloseHandle(handle);
+        return false;
+    }
+    slot = handle;
+    return true;
+}
+
+// Runs the handshake. Every blocking call works on a local copy of a published handle and
+// fails with ERROR_WINHTTP_OPERATION_CANCELLED once CloseHandles() closes it.
+bool WebSocketClient::OpenConnection(Connection& conn, HINTERNET replacing) {
+    auto fail = [this](const char* stage) {
+        DWORD err = GetLastError();
+        if (m_shouldStop)
+            LOG_DEBUG("{} cancelled: error {}", stage, err);
+        else
+            LOG_WARN("{} failed: error {}", stage, err);
+        return false;
+    };
+
+    HINTERNET hSession = Session();
+    if (!hSession) return fail("WinHttpOpen");
+
+    LARGE_INTEGER t0, t1, connected{}, sent, received;
+    QueryPerformanceCounter(&t0);
+    // Only the very first connection waits for discovery; Disconnect() cancels that wait
+    ProxyResolver::Route route;
+    bool cached = false;
+    if (!m_proxy.Get(PROXY_LOOKUP_URL, [this] { return m_shouldStop.load(); }, route, cached)) {
+        LOG_DEBUG("Proxy lookup cancelled");
+        return false;
+    }
+    QueryPerformanceCounter(&t1);
+
+    HINTERNET hConnect = WinHttpConnect(hSession, m_host.c_str(), m_port, 0);
+    if (!hConnect) return fail("WinHttpConnect");
+    if (!Publish(conn.hConnect, hConnect, replacing)) return false;
+
+    HINTERNET hRequest = WinHttpOpenRequest(hConnect, L"GET", m_path.c_str(),
+        nullptr, nullptr, nullptr, WINHTTP_FLAG_SECURE);
+    if (!hRequest) return fail("WinHttpOpenRequest");
+    if (!Publish(conn.hRequest, hRequest, replacing)) return false;
+
+    // WinHTTP opens an HTTP CONNECT tunnel through a named proxy for the secure request
+    if (!route.proxy.empty()) {
+        WINHTTP_PROXY_INFO proxy{ WINHTTP_ACCESS_TYPE_NAMED_PROXY,
+            route.proxy.data(), route.bypass.empty() ? nullptr : route.bypass.data() };
+        if (!WinHttpSetOption(hRequest, WINHTTP_OPTION_PROXY, &proxy, sizeof(proxy)))
+            return fail("WinHttpSetOption(PROXY)");
+    }
+
+    // Request WebSocket upgrade
+    if (!WinHttpSetOption(hRequest, WINHTTP_OPTION_UPGRADE_TO_WEB_SOCKET, nullptr, 0))
+        return fail("WinHttpSetOption(UPGRADE_TO_WEB_SOCKET)");
+
+    // The connect happens inside the send; the callback is removed again before `connected`
+    // goes out of scope
+    WinHttpSetStatusCallback(hRequest, OnHandshakeStatus, WINHTTP_CALLBACK_FLAG_CONNECTED_TO_SERVER, 0);
+    BOOL ok = WinHttpSendRequest(hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0, nullptr, 0, 0,
+        reinterpret_cast<DWORD_PTR>(&connected));
+    QueryPerformanceCounter(&sent);
+    DWORD sendErr = GetLastError();
+    WinHttpSetStatusCallback(hRequest, nullptr, 0, 0);
+    if (!ok) {
+        SetLastError(sendErr);
+        return fail("WinHttpSendRequest");
+    }
+
+    if (!WinHttpReceiveResponse(hRequest, nullptr))
+        return fail("WinHttpReceiveResponse");
+    QueryPerformanceCounter(&received);
+
+    HINTERNET hWebSocket = WinHttpWebSocketCompleteUpgrade(hRequest, 0);
+    if (!hWebSocket) return fail("WinHttpWebSocketCompleteUpgrade");
+    if (!Publish(conn.hWebSocket, hWebSocket, replacing)) return false;
+
+    // No CONNECTED_TO_SERVER when WinHTTP reused a pooled connection: all of it counts as tunnel
+    ConnectTimings timings;
+    timings.proxyUs = ElapsedUs(t0, t1);
+    timings.connectUs = connected.QuadPart ? ElapsedUs(t1, connected) : 0;
+    timings.tunnelUs = ElapsedUs(connected.QuadPart ? connected : t1, sent);
+    timings.upgradeUs = ElapsedUs(sent, received);
+    timings.proxyCached = cached;
+    timings.viaProxy = !route.proxy.empty();
+    LOG_INFO("Handshake: proxy lookup {} us, connect {} us, tunnel+TLS {} us, upgrade {} us",
+        timings.proxyUs, timings.connectUs, timings.tunnelUs, timings.upgradeUs);
+
+    // The request handle stays open until the connection closes: the kernel TCP statistics
+    // in GetTransportStats() are queried through it
+    std::lock_guard lock(m_handleMutex);
+    conn.openedTick = GetTickCount64();
+    timings.completedTick = conn.openedTick;
+    m_lastConnect = timings;
+    return true;
+}
+
+void WebSocketClient::WorkerThread(std::thread previous, uint64_t run, std::wstring path) {
+    // The worker of an earlier run may still be unwinding from a stalled call
+    if (previous.joinable()) previous.join();
+    {
+        std::lock_guard lock(m_handleMutex);
+        if (m_stoppedRun >= run) return; // Disconnect() was called meanwhile
+        m_shouldStop = false;
+        m_path = std::move(path);
+    }
+
+    // The handover thread belongs to this run; Send() only signals it
+    m_handoverRunning = false;
+    std::thread handover(&WebSocketClient::HandoverLoop, this);
+
     while (!m_shouldStop) {
         m_state = State::Connecting;
-        if (m_onStateChange) m_onStateChange(State::Connecting);
+        NotifyState(State::Connecting);
 
-        // Build path with query params
-        std::wstring path = L"/prod?awsid=" + awsId + L"&license=" + license;
+        if (OpenConnection(m_active)) {
+            m_handedOver = false;
+            {
+                std::lock_guard lock(m_healthMutex);
+                m_health.Reset();
+            }
+            m_state = State::Connected;
+            ResetEvent(m_wakeEvent); // A wake requested while connecting is already satisfied
+            LOG_INFO("WebSocket connected");
+            NotifyState(State::Connected);
 
-        m_hSession = WinHttpOpen(L"WolSkill/1.0",
-            WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, nullptr, nullptr, 0);
-        if (!m_hSession) goto reconnect;
+            for (;;) {
+                ReceiveLoop(ActiveWebSocket());
+                if (m_shouldStop) break;
 
-        // Enable TLS 1.2+
-        {
-            DWORD protocols = WINHTTP_FLAG_SECURE_PROTOCOL_TLS1_2 | WINHTTP_FLAG_SECURE_PROTOCOL_TLS1_3;
-            WinHttpSetOption(m_hSession, WINHTTP_OPTION_SECURE_PROTOCOLS, &protocols, sizeof(protocols));
+                // The degraded connection may die while its replacement is still being
+                // confirmed; wait for the outcome rather than starting from scratch
+                if (!m_handedOver && m_handoverRunning) {
+                    LOG_INFO("Active connection lost during handover, waiting for standby");
+                    WaitForHandover();
+                }
+                if (!m_handedOver.exchange(false)) break;
+                LOG_DEBUG("Receiving on handed-over connection");
+            }
+        }
+
+        // With the active connection closed, a handover attempt still in its handshake cannot
+        // publish a standby; closing the standby ends one that already has
+        CloseHandles(m_active);
+        CloseHandles(m_standby);
+        WaitForHandover();
+        m_state = State::Disconnected;
+        LOG_DEBUG("WebSocket disconnected, stop={}", m_shouldStop.load());
+        NotifyState(State::Disconnected);
+
+        // Wait before reconnecting; Reconnect() and Disconnect() cut this short
+        if (!m_shouldStop)
+            WaitForSingleObject(m_wakeEvent, ReconnectPolicy::kReconnectDelayMs);
+    }
+
+    // m_shouldStop is set, so the loop returns once it wakes
+    CloseHandles(m_standby);
+    SetEvent(m_handoverEvent);
+    handover.join();
+}
+
+void WebSocketClient::ReceiveLoop(HINTERNET hWebSocket) {
+    if (!hWebSocket) return;
+
+    std::string accumulated = m_dispatcher.Acquire();
+    Utf8::State utf8;
+
+    while (!m_shouldStop) {
+        DWORD bytesRead = 0;
+        WINHTTP_WEB_SOCKET_BUFFER_TYPE bufType;
+        DWORD err = WinHttpWebSocketReceive(hWebSocket,
+            m_receiveBuffer, sizeof(m_receiveBuffer), &bytesRead, &bufType);
+
+        if (err != NO_ERROR) {
+            if (!m_shouldStop && !m_handedOver) LOG_WARN("WinHttpWebSocketReceive failed: error {}", err);
+            break;
         }
 
-        m_hConnect = WinHttpConnect(m_hSession, WS_HOST, WS_PORT, 0);
-        if (!m_hConnect) goto reconnect;
+        if (bufType == WINHTTP_WEB_SOCKET_CLOSE_BUFFER_TYPE) {
+            LOG_INFO("WebSocket closed by server");
+            break;
+        }
 
-        m_hRequest = WinHttpOpenRequest(m_hConnect, L"GET", path.c_str(),
-            nullptr, nullptr, nullptr, WINHTTP_FLAG_SECURE);
-        if (!m_hRequest) goto reconnect;
+        LOG_TRACE("recv frame: {} bytes, type {}", bytesRead, bufType);
 
-        // Request WebSocket upgrade
-        if (!WinHttpSetOption(m_hRequest, WINHTTP_OPTION_UPGRADE_TO_WEB_SOCKET, nullptr, 0))
-            goto reconnect;
+        if (!AppendFrame(accumulated, m_receiveBuffer, bytesRead, bufType, utf8)) break;
 
-        if (!WinHttpSendRequest(m_hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0,
-            nullptr, 0, 0, 0))
-            goto reconnect;
+        // Check if this is a complete message (not a fragment); handling happens on the
+        // dispatcher thread so the next receive is issued immediately
+        if (bufType == WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE ||
+            bufType == WINHTTP_WEB_SOCKET_BINARY_MESSAGE_BUFFER_TYPE) {
+            bool control = IsControlMessage(accumulated);
+            if (control) {
+                std::lock_guard lock(m_healthMutex);
+                m_health.OnPong(GetTickCount64());
+            }
+            m_dispatcher.Post(std::move(accumulated), control);
+            accumulated = m_dispatcher.Acquire();
+        }
+    }
+}
 
-        if (!WinHttpReceiveResponse(m_hRequest, nullptr))
-            goto reconnect;
+// ---------- Make-before-break handover ----------
 
-        m_hWebSocket = WinHttpWebSocketCompleteUpgrade(m_hRequest, 0);
-        if (!m_hWebSocket) goto reconnect;
+// Called with m_sendMutex held, right after a report went out on the active connection.
+// Only signals the handover thread, so Send() never waits for a connection attempt.
+// Called by Send() with the report it just sent; only a requested handover copies it
+void WebSocketClient::MaybeRequestHandover(ULONGLONG now, const std::string& report) {
+    int score;
+    {
+        std::lock_guard lock(m_healthMutex);
+        score = m_health.Score();
+    }
+    ULONGLONG openedTick;
+    {
+        std::lock_guard lock(m_handleMutex);
+        openedTick = m_active.openedTick;
+    }
+    const char* reason = m_reconnectPolicy.HandoverReason(now, score, openedTick);
+    if (!reason || m_shouldStop) return;
+    if (m_handoverRunning.exchange(true)) return;
 
-        // Close the request handle; we use the WebSocket handle from now on
-        WinHttpCloseHandle(m_hRequest);
-        m_hRequest = nullptr;
+    m_reconnectPolicy.OnHandoverAttempt(now);
+    m_handoverProbe = report;
+    LOG_INFO("Requesting handover ({}), health score {}", reason, score);
+    SetEvent(m_handoverEvent);
+}
 
-        m_state = State::Connected;
-        if (m_onStateChange) m_onStateChange(State::Connected);
+// Worker: waits until no handover attempt is pending or running. On a stop the worker
+// joins the handover thread instead.
+void WebSocketClient::WaitForHandover() {
+    std::unique_lock lock(m_handoverMutex);
+    m_handoverDone.wait(lock, [this] { return !m_handoverRunning || m_shouldStop; });
+}
 
-        // Receive loop
+void WebSocketClient::FinishHandover() {
+    {
+        std::lock_guard lock(m_handoverMutex);
+        m_handoverRunning = false;
+    }
+    m_handoverDone.notify_all();
+}
+
+// Started and joined by the worker, once per Connect()
+void WebSocketClient::HandoverLoop() {
+    while (WaitForSingleObject(m_handoverEvent, INFINITE) == WAIT_OBJECT_0 && !m_shouldStop) {
+        if (!m_handoverRunning) continue;
+        std::string probe;
         {
-            std::vector<BYTE> buf(4096);
-            std::string accumulated;
+            std::lock_guard lock(m_sendMutex);
+            probe = std::move(m_handoverProbe);
+        }
+        RunHandover(probe);
+        FinishHandover();
+    }
+    FinishHandover();
+}
 
-            while (!m_shouldStop) {
-                DWORD bytesRead = 0;
-                WINHTTP_WEB_SOCKET_BUFFER_TYPE bufType;
-                DWORD err = WinHttpWebSocketReceive(m_hWebSocket,
-                    buf.data(), static_cast<DWORD>(buf.size()), &bytesRead, &bufType);
+// Timer-queue callback: the standby did not answer its probe in time
+void CALLBACK WebSocketClient::OnStandbyTimeout(PVOID param, BOOLEAN) {
+    auto* self = static_cast<WebSocketClient*>(param);
+    std::lock_guard lock(self->m_handleMutex);
+    if (self->m_standbyConfirmed) return;
+    Connection& c = self->m_standby;
+    CloseConnectionHandles(c.hWebSocket, c.hRequest, c.hConnect);
+}
 
-                if (err != NO_ERROR) break;
+void WebSocketClient::RunHandover(const std::string& probe) {
+    m_standbyConfirmed = false;
+    bool confirmed = false;
+    HANDLE timer = nullptr;
+    ULONGLONG sentAt = 0;
 
-                if (bufType == WINHTTP_WEB_SOCKET_CLOSE_BUFFER_TYPE) break;
+    // The connection this attempt replaces; if the worker has moved on, the standby is not used
+    HINTERNET replacing = ActiveWebSocket();
+    if (replacing && OpenConnection(m_standby, replacing)) {
+        HINTERNET hStandby;
+        {
+            std::lock_guard lock(m_handleMutex);
+            hStandby = m_standby.hWebSocket;
+        }
+        CreateTimerQueueTimer(&timer, nullptr, OnStandbyTimeout, this,
+            static_cast<DWORD>(ConnectionHealth::kPongTimeoutMs), 0, WT_EXECUTEONLYONCE);
+
+        sentAt = GetTickCount64();
+        DWORD err = hStandby ? WinHttpWebSocketSend(hStandby,
+            WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE,
+            const_cast<void*>(static_cast<const void*>(probe.c_str())),
+            static_cast<DWORD>(probe.size())) : ERROR_INVALID_HANDLE;
 
-                accumulated.append(reinterpret_cast<char*>(buf.data()), bytesRead);
+        std::string accumulated = m_dispatcher.Acquire();
+        Utf8::State utf8;
+        while (err == NO_ERROR && !m_shouldStop) {
+            DWORD bytesRead = 0;
+            WINHTTP_WEB_SOCKET_BUFFER_TYPE bufType;
+            err = WinHttpWebSocketReceive(hStandby,
+                m_standbyBuffer, sizeof(m_standbyBuffer), &bytesRead, &bufType);
+            if (err != NO_ERROR || bufType == WINHTTP_WEB_SOCKET_CLOSE_BUFFER_TYPE) break;
 
-                // Check if this is a complete message (not a fragment)
-                if (bufType == WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE ||
-                    bufType == WINHTTP_WEB_SOCKET_BINARY_MESSAGE_BUFFER_TYPE) {
-                    if (m_onMessage) m_onMessage(accumulated);
-                    accumulated.clear();
+            if (!AppendFrame(accumulated, m_standbyBuffer, bytesRead, bufType, utf8)) break;
+            if (bufType == WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE ||
+                bufType == WINHTTP_WEB_SOCKET_BINARY_MESSAGE_BUFFER_TYPE) {
+                // Commands can already arrive on the standby; they are handled like any other
+                bool control = IsControlMessage(accumulated);
+                m_dispatcher.Post(std::move(accumulated), control);
+                accumulated = m_dispatcher.Acquire();
+                if (control) {
+                    confirmed = true;
+                    break;
                 }
             }
         }
 
-    reconnect:
-        CloseHandles();
-        m_state = State::Disconnected;
-        if (m_onStateChange) m_onStateChange(State::Disconnected);
+        if (confirmed) {
+            // Swap only if the timeout did not close the standby first
+            std::lock_guard lock(m_handleMutex);
+            if (m_standby.hWebSocket && m_active.hWebSocket == replacing && !m_shouldStop) {
+                m_standbyConfirmed = true;
+                std::swap(m_active, m_standby);
+                m_handedOver = true;
+            } else {
+                confirmed = false;
+            }
+        }
+    }
+
+    if (timer) DeleteTimerQueueTimer(nullptr, timer, INVALID_HANDLE_VALUE);
+
+    // After a swap m_standby holds the old connection: closing it releases the worker's
+    // receive, which then continues on the new active connection
+    CloseHandles(m_standby);
+
+    if (confirmed) {
+        {
+            std::lock_guard lock(m_healthMutex);
+            m_health.Reset();
+        }
+        LOG_INFO("Handover complete, standby confirmed in {} ms", GetTickCount64() - sentAt);
+    } else if (!m_shouldStop) {
+        LOG_WARN("Handover failed, keeping the current connection");
+    }
+}
+
+// ---------- Stalled-server test ----------
+
+// TCP listener on an ephemeral loopback port; INVALID_SOCKET on failure
+static SOCKET ListenLoopback(INTERNET_PORT& port) {
+    SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int addrLen = sizeof(addr);
+    if (listener == INVALID_SOCKET ||
+        bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(listener, SOMAXCONN) != 0 ||
+        getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addrLen) != 0) {
+        printf("Listener setup failed: error %d\n", WSAGetLastError());
+        if (listener != INVALID_SOCKET) closesocket(listener);
+        return INVALID_SOCKET;
+    }
+    port = ntohs(addr.sin_port);
+    return listener;
+}
+
+// Connects to a local listener that accepts the TCP connection and never sends a byte, so the
+// worker is stuck in the TLS handshake, and stops it after a varying delay. Then does the same
+// with the dispatcher's normal lane full, a slow handler (an adapter scan, a shutdown with its
+// log flush) and a receive thread held by backpressure. Fails when a Disconnect() exceeds
+// DISCONNECT_TIMEOUT_MS or has to leave its worker behind.
+int WebSocketClient::RunDisconnectTest(int rounds) {
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        printf("WSAStartup failed\n");
+        return 1;
+    }
+
+    INTERNET_PORT port = 0;
+    SOCKET listener = ListenLoopback(port);
+    if (listener == INVALID_SOCKET) {
+        WSACleanup();
+        return 1;
+    }
+
+    // Accepted sockets stay open and silent until the test ends
+    std::vector<SOCKET> accepted;
+    std::thread acceptor([&] {
+        for (;;) {
+            SOCKET s = accept(listener, nullptr, nullptr);
+            if (s == INVALID_SOCKET) break;
+            accepted.push_back(s);
+        }
+    });
+
+    static const DWORD delays[] = { 0, 10, 100, 500, 2000 };
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
 
-        // Wait before reconnecting (5 seconds), checking stop flag
-        for (int i = 0; i < 50 && !m_shouldStop; ++i)
-            Sleep(100);
+    printf("Stalled server on 127.0.0.1:%u, Disconnect() bound %lu ms\n\n", port, DISCONNECT_TIMEOUT_MS);
+    int failures = 0;
+    double worst = 0;
+    {
+        WebSocketClient client;
+        client.SetEndpoint(L"127.0.0.1", port);
+        client.SetProxyOverride(L"direct");
+        for (int i = 0; i < rounds; ++i) {
+            DWORD delay = delays[i % (sizeof(delays) / sizeof(delays[0]))];
+            client.Connect(L"test", L"test");
+            Sleep(delay);
+
+            LARGE_INTEGER t0, t1;
+            QueryPerformanceCounter(&t0);
+            client.Disconnect();
+            QueryPerformanceCounter(&t1);
+            double ms = (t1.QuadPart - t0.QuadPart) * 1000.0 / freq.QuadPart;
+            bool abandoned = client.m_abandoned.joinable();
+            bool failed = ms > DISCONNECT_TIMEOUT_MS || abandoned;
+            if (ms > worst) worst = ms;
+            if (failed) ++failures;
+            printf("  round %2d: stopped after %4lu ms, Disconnect() %7.2f ms%s\n", i + 1, delay, ms,
+                abandoned ? "  FAIL (worker left running)" : failed ? "  FAIL" : "");
+        }
+    }
+
+    printf("\nFull dispatch queue:\n");
+    static const DWORD handlerDelays[] = { 50, 300, 3000 };
+    static const char command[] = "{\"value\":\"00-00-00-00-00-00\"}";
+    for (DWORD handlerMs : handlerDelays) {
+        WebSocketClient client;
+        client.SetEndpoint(L"127.0.0.1", port);
+        client.SetProxyOverride(L"direct");
+        client.SetCallbacks([handlerMs](const std::string&) { Sleep(handlerMs); }, nullptr);
+        client.Connect(L"test", L"test");
+        for (size_t i = 0; i <= MessageDispatcher::kMaxQueuedMessages; ++i)
+            client.m_dispatcher.Post(command, false);
+        // Stands in for the receive thread, waiting for room in the full lane
+        std::thread receiver([&client] { client.m_dispatcher.Post(command, false); });
+        Sleep(50);
+
+        LARGE_INTEGER t0, t1;
+        QueryPerformanceCounter(&t0);
+        client.Disconnect();
+        QueryPerformanceCounter(&t1);
+        receiver.join();
+        double ms = (t1.QuadPart - t0.QuadPart) * 1000.0 / freq.QuadPart;
+        bool abandoned = client.m_abandoned.joinable();
+        bool failed = ms > DISCONNECT_TIMEOUT_MS || abandoned;
+        if (ms > worst) worst = ms;
+        if (failed) ++failures;
+        MessageDispatcher::Stats ds = client.GetDispatchStats();
+        printf("  handler %4lu ms: Disconnect() %7.2f ms, %llu commands discarded%s\n", handlerMs, ms,
+            static_cast<unsigned long long>(ds.discarded),
+            abandoned ? "  FAIL (worker left running)" : failed ? "  FAIL" : "");
+        ++rounds;
     }
+
+    closesocket(listener);
+    acceptor.join();
+    for (SOCKET s : accepted) closesocket(s);
+    WSACleanup();
+
+    printf("\n%d/%d rounds within the bound, worst %.2f ms\n", rounds - failures, rounds, worst);
+    return failures == 0 ? 0 : 1;
+}
+
+// ---------- Stand-in proxy test ----------
+
+namespace {
+
+// Loopback server that plays both the PAC server and the proxy. GET /proxy.pac returns a script
+// that routes everything through this server; GET /stall.pac is never answered, so discovery
+// hangs until it is cancelled or times out. CONNECT is answered with 200 and then nothing, so
+// the client sits in the TLS handshake through the tunnel.
+class StandInProxy {
+public:
+    bool Start() {
+        m_listener = ListenLoopback(m_port);
+        if (m_listener == INVALID_SOCKET) return false;
+        m_acceptor = std::thread([this] {
+            for (;;) {
+                SOCKET s = accept(m_listener, nullptr, nullptr);
+                if (s == INVALID_SOCKET) break;
+                std::lock_guard lock(m_mutex);
+                m_sockets.push_back(s);
+                m_handlers.emplace_back(&StandInProxy::Serve, this, s);
+            }
+        });
+        return true;
+    }
+
+    void Stop() {
+        closesocket(m_listener);
+        if (m_acceptor.joinable()) m_acceptor.join();
+        // Closing the accepted sockets ends the handlers' receives
+        for (SOCKET s : m_sockets) closesocket(s);
+        for (std::thread& t : m_handlers) t.join();
+    }
+
+    INTERNET_PORT Port() const { return m_port; }
+
+    int Tunnels() {
+        std::lock_guard lock(m_mutex);
+        return m_tunnels;
+    }
+
+    // Waits until more than `seen` CONNECT requests arrived; false after `timeoutMs`
+    bool WaitForTunnel(int seen, DWORD timeoutMs, std::string& target) {
+        std::unique_lock lock(m_mutex);
+        if (!m_tunnel.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] { return m_tunnels > seen; }))
+            return false;
+        target = m_target;
+        return true;
+    }
+
+private:
+    void Serve(SOCKET s) {
+        std::string request;
+        char buf[1024];
+        while (request.find("\r\n\r\n") == std::string::npos) {
+            int n = recv(s, buf, sizeof(buf), 0);
+            if (n <= 0) return;
+            request.append(buf, n);
+        }
+
+        if (request.compare(0, 8, "CONNECT ") == 0) {
+            static const char ok[] = "HTTP/1.1 200 Connection established\r\n\r\n";
+            send(s, ok, sizeof(ok) - 1, 0);
+            std::lock_guard lock(m_mutex);
+            m_target = request.substr(8, request.find(' ', 8) - 8);
+            ++m_tunnels;
+            m_tunnel.notify_all();
+        } else if (request.find(" /proxy.pac ") != std::string::npos) {
+            char script[128];
+            int len = snprintf(script, sizeof(script),
+                "function FindProxyForURL(url, host) { return \"PROXY 127.0.0.1:%u\"; }\n", m_port);
+            char response[256];
+            int total = snprintf(response, sizeof(response),
+                "HTTP/1.1 200 OK\r\nContent-Type: application/x-ns-proxy-autoconfig\r\n"
+                "Content-Length: %d\r\nConnection: close\r\n\r\n%s", len, script);
+            send(s, response, total, 0);
+        }
+    }
+
+    SOCKET m_listener = INVALID_SOCKET;
+    INTERNET_PORT m_port = 0;
+    std::thread m_acceptor;
+    std::mutex m_mutex;
+    std::condition_variable m_tunnel;
+    std::vector<SOCKET> m_sockets;
+    std::vector<std::thread> m_handlers;
+    int m_tunnels = 0;
+    std::string m_target;
+};
+
+} // namespace
+
+// Three checks against the stand-in proxy. A discovery that never finishes must not hold up
+// Disconnect(). A served PAC file must route the handshake through the proxy's CONNECT tunnel.
+// After a network change, with the refresh stalled, a reconnect must use the last route at once
+// instead of waiting for it.
+int WebSocketClient::RunProxyTest(int rounds) {
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        printf("WSAStartup failed\n");
+        return 1;
+    }
+    StandInProxy proxy;
+    if (!proxy.Start()) {
+        WSACleanup();
+        return 1;
+    }
+
+    wchar_t stallPac[64], servedPac[64];
+    swprintf(stallPac, 64, L"http://127.0.0.1:%u/stall.pac", proxy.Port());
+    swprintf(servedPac, 64, L"http://127.0.0.1:%u/proxy.pac", proxy.Port());
+    // Only the proxy ever sees this name, in the CONNECT request
+    static constexpr const wchar_t* TEST_HOST = L"gateway.wolskill.test";
+    static constexpr const char* TEST_TARGET = "gateway.wolskill.test:443";
+    static constexpr DWORD TUNNEL_WAIT_MS = 10000;
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    auto elapsedMs = [&freq](const LARGE_INTEGER& from) {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        return (now.QuadPart - from.QuadPart) * 1000.0 / freq.QuadPart;
+    };
+
+    printf("Stand-in proxy on 127.0.0.1:%u, Disconnect() bound %lu ms\n\n", proxy.Port(), DISCONNECT_TIMEOUT_MS);
+    int failures = 0;
+
+    // A fresh client has no route, so its first connection waits for the stalled discovery
+    static const DWORD delays[] = { 0, 10, 100, 500, 2000 };
+    printf("Stalled discovery:\n");
+    for (int i = 0; i < rounds; ++i) {
+        DWORD delay = delays[i % (sizeof(delays) / sizeof(delays[0]))];
+        WebSocketClient client;
+        client.SetEndpoint(TEST_HOST, INTERNET_DEFAULT_HTTPS_PORT);
+        client.m_proxy.SetAutoConfigUrl(stallPac);
+        client.Connect(L"test", L"test");
+        Sleep(delay);
+
+        LARGE_INTEGER t0;
+        QueryPerformanceCounter(&t0);
+        client.Disconnect();
+        double ms = elapsedMs(t0);
+        bool abandoned = client.m_abandoned.joinable();
+        bool failed = ms > DISCONNECT_TIMEOUT_MS || abandoned;
+        if (failed) ++failures;
+        printf("  round %2d: stopped after %4lu ms, Disconnect() %7.2f ms%s\n", i + 1, delay, ms,
+            abandoned ? "  FAIL (worker left running)" : failed ? "  FAIL" : "");
+    }
+
+    {
+        WebSocketClient client;
+        client.SetEndpoint(TEST_HOST, INTERNET_DEFAULT_HTTPS_PORT);
+        client.m_proxy.SetAutoConfigUrl(servedPac);
+
+        printf("\nServed PAC file:\n");
+        std::string target;
+        int seen = proxy.Tunnels();
+        LARGE_INTEGER t0;
+        QueryPerformanceCounter(&t0);
+        client.Connect(L"test", L"test");
+        if (proxy.WaitForTunnel(seen, TUNNEL_WAIT_MS, target) && target == TEST_TARGET) {
+            printf("  tunnel to %s after %7.2f ms (discovery %lu ms)\n", target.c_str(), elapsedMs(t0),
+                client.GetProxyRoute().resolveMs);
+        } else {
+            ++failures;
+            printf("  FAIL: no CONNECT %s within %lu ms\n", TEST_TARGET, TUNNEL_WAIT_MS);
+        }
+
+        printf("\nNetwork change with a stalled refresh:\n");
+        client.m_proxy.SetAutoConfigUrl(stallPac);
+        client.OnNetworkChanged();
+        seen = proxy.Tunnels();
+        QueryPerformanceCounter(&t0);
+        client.Reconnect();
+        // The reconnect skips the backoff, so only the handshake is between it and the tunnel
+        if (proxy.WaitForTunnel(seen, DISCONNECT_TIMEOUT_MS, target)) {
+            printf("  tunnel on the last route after %7.2f ms\n", elapsedMs(t0));
+        } else {
+            ++failures;
+            printf("  FAIL: reconnect waited for the refresh\n");
+        }
+
+        QueryPerformanceCounter(&t0);
+        client.Disconnect();
+        double ms = elapsedMs(t0);
+        bool failed = ms > DISCONNECT_TIMEOUT_MS || client.m_abandoned.joinable();
+        if (failed) ++failures;
+        printf("  Disconnect() %7.2f ms%s\n", ms, failed ? "  FAIL" : "");
+    }
+
+    proxy.Stop();
+    WSACleanup();
+
+    printf("\n%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
 }
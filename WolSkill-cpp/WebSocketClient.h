@@ -6,6 +6,11 @@
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include "ConnectionHealth.h"
+#include "MessageDispatcher.h"
+#include "ProxyResolver.h"
+#include "ReconnectPolicy.h"
 
 class WebSocketClient {
 public:
@@ -21,26 +26,131 @@ public:
     WebSocketClient(const WebSocketClient&) = delete;
     WebSocketClient& operator=(const WebSocketClient&) = delete;
 
+    // The message callback applies from the next Connect()
     void SetCallbacks(MessageCallback onMsg, StateCallback onState);
     void Connect(const std::wstring& awsId, const std::wstring& license);
     void Disconnect();
+    // Drop the current connection (if any) and connect again without the backoff delay
+    void Reconnect();
     void Send(const std::string& data);
     State GetState() const { return m_state.load(); }
+    MessageDispatcher::Stats GetDispatchStats() const { return m_dispatcher.GetStats(); }
+    int GetHealthScore() const;
+
+    // Kernel TCP statistics of the active connection (Windows 10 2004 and later)
+    struct TransportStats {
+        ULONG rttUs = 0;           // Smoothed RTT
+        ULONG minRttUs = 0;
+        ULONG64 bytesRetransmitted = 0;
+        ULONG timeoutEpisodes = 0; // Retransmission timeouts
+    };
+    bool GetTransportStats(TransportStats& stats);
+
+    // Where the last handshake spent its time
+    struct ConnectTimings {
+        ULONG proxyUs = 0;   // Proxy lookup; next to nothing when the cached route was used
+        ULONG connectUs = 0; // Name resolution and TCP connect to the proxy or the gateway
+        ULONG tunnelUs = 0;  // CONNECT through the proxy (if any), TLS and sending the upgrade
+        ULONG upgradeUs = 0; // Until the upgrade response arrived
+        bool proxyCached = false;
+        bool viaProxy = false;
+        ULONGLONG completedTick = 0; // 0 until the first handshake
+    };
+    ConnectTimings GetConnectTimings();
+
+    // `Proxy` registry value: empty for discovery, "direct" or host:port
+    void SetProxyOverride(const std::wstring& proxy) { m_proxy.SetOverride(proxy); }
+    // Re-resolves the proxy in the background; connections keep using the last route until it
+    // is done
+    void OnNetworkChanged() { m_proxy.Invalidate(); }
+    ProxyResolver::Route GetProxyRoute() const { return m_proxy.Current(); }
+
+    // Small server replies such as {"value":"pong"} take the dispatcher's priority lane
+    static bool IsControlMessage(const std::string& msg);
+
+    // Test hook: connect to another endpoint than the gateway
+    void SetEndpoint(const std::wstring& host, INTERNET_PORT port) { m_host = host; m_port = port; }
+
+    // Disconnect() latency against a local server that accepts and never answers
+    static int RunDisconnectTest(int rounds);
+    // Proxy discovery and tunnelling against a local stand-in PAC server and proxy
+    static int RunProxyTest(int rounds);
 
 private:
-    void WorkerThread(std::wstring awsId, std::wstring license);
+    // Handles of one WebSocket connection
+    struct Connection {
+        HINTERNET hConnect = nullptr;
+        HINTERNET hRequest = nullptr;
+        HINTERNET hWebSocket = nullptr;
+        ULONGLONG openedTick = 0;
+    };
+
+    void WorkerThread(std::thread previous, uint64_t run, std::wstring path);
+    bool OpenConnection(Connection& conn, HINTERNET replacing = nullptr);
+    void ReceiveLoop(HINTERNET hWebSocket);
+    bool Publish(HINTERNET& slot, HINTERNET handle, HINTERNET replacing);
+    void CloseHandles(Connection& conn);
     void CloseHandles();
+    HINTERNET ActiveWebSocket();
+    HINTERNET Session();
+
+    void MaybeRequestHandover(ULONGLONG now, const std::string& report);
+    void WaitForHandover();
+    void FinishHandover();
+    void HandoverLoop();
+    void RunHandover(const std::string& probe);
+    static void CALLBACK OnStandbyTimeout(PVOID param, BOOLEAN);
+    void NotifyState(State state);
 
     std::atomic<State> m_state{ State::Disconnected };
     std::atomic<bool> m_shouldStop{ false };
+    HANDLE m_wakeEvent = nullptr; // Cuts the reconnect backoff short
     std::thread m_thread;
-    std::mutex m_sendMutex;
+    // A worker that missed the Disconnect() deadline; it finishes on its own, and the next
+    // worker joins it before touching any state
+    std::thread m_abandoned;
+    uint64_t m_runId = 0;      // Bumped by Connect(); guarded by m_handleMutex
+    uint64_t m_stoppedRun = 0; // Last run Disconnect() stopped; guarded by m_handleMutex
+    std::wstring m_path;
+    std::wstring m_host;
+    INTERNET_PORT m_port;
+    std::mutex m_sendMutex;   // Serializes WinHttpWebSocketSend calls
+    std::mutex m_handleMutex; // Guards the connections below; never held across a blocking call
+
+    // One session for every connection: its options are set once, and the proxy route is
+    // applied per request from the resolver's cache instead of being discovered per connect
+    HINTERNET m_session = nullptr;
+    ProxyResolver m_proxy;
+    ConnectTimings m_lastConnect;
+
+    Connection m_active;      // The connection the worker receives on
+    Connection m_standby;     // Make-before-break replacement while a handover runs
+    HINTERNET m_sendingOn = nullptr;      // WebSocket handle a Send() is using
+    HINTERNET m_closeAfterSend = nullptr; // Closed by that Send() when it returns
+
+    // Receive buffers are part of the client rather than allocated per connection; the
+    // worker and the handover thread each own one, so a swap never moves a buffer in use
+    static constexpr DWORD kReceiveBufferSize = 4096;
+    BYTE m_receiveBuffer[kReceiveBufferSize];
+    BYTE m_standbyBuffer[kReceiveBufferSize];
+
+    // Handover: a second connection is opened and confirmed with a pong before the
+    // active one is closed, so there is no window in which commands cannot arrive.
+    // The attempt runs on a thread the worker owns; Send() only sets m_handoverEvent.
+    HANDLE m_handoverEvent = nullptr;
+    std::mutex m_handoverMutex;           // Only for m_handoverDone
+    std::condition_variable m_handoverDone;
+    std::atomic<bool> m_handoverRunning{ false }; // Requested or in progress
+    std::atomic<bool> m_handedOver{ false }; // Tells the worker the active connection was swapped
+    std::atomic<bool> m_standbyConfirmed{ false };
+    ReconnectPolicy m_reconnectPolicy; // Guarded by m_sendMutex
 
-    HINTERNET m_hSession = nullptr;
-    HINTERNET m_hConnect = nullptr;
-    HINTERNET m_hRequest = nullptr;
-    HINTERNET m_hWebSocket = nullptr;
+    mutable std::mutex m_healthMutex;
+    ConnectionHealth m_health;
+    std::string m_handoverProbe; // Report that requested the handover, replayed on the standby; guarded by m_sendMutex
 
+    MessageDispatcher m_dispatcher; // Runs m_onMessage off the receive thread
+    std::mutex m_callbackMutex; // A worker left running may still report its state
     MessageCallback m_onMessage;
     StateCallback m_onStateChange;
 };
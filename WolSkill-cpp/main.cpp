@@ -1,14 +1,28 @@
 #include <Windows.h>
 #include <shellapi.h>
 #include <commctrl.h>
+#include <cstdio>
+#include <cstdlib>
 #include <strsafe.h>
+#include <algorithm>
+#include <string>
+#include <vector>
 
 #include "resource.h"
 #include "Settings.h"
 #include "WebSocketClient.h"
 #include "NetworkInfo.h"
+#include "NeighborInventory.h"
 #include "ThemeHelper.h"
-#include <winrt/Windows.Foundation.h>
+#include "HeartbeatScheduler.h"
+#include "ConnectionLifecycle.h"
+#include "ReconnectPolicy.h"
+#include "Simulation.h"
+#include "NetworkMonitor.h"
+#include "ControlChannel.h"
+#include "MemoryBudget.h"
+#include "Utf8Validator.h"
+#include "Log.h"
 
 #pragma comment(lib, "comctl32.lib")
 #pragma comment(linker, "\"/manifestdependency:type='win32' \
@@ -25,10 +39,55 @@ static HINSTANCE g_hInst = nullptr;
 static NOTIFYICONDATAW g_nid{};
 static Settings g_settings;
 static WebSocketClient g_wsClient;
-static bool g_connected = false;
 static HICON g_iconConnected = nullptr;
 static HICON g_iconDisconnected = nullptr;
 static HBRUSH g_editBrush = nullptr;
+static HPOWERNOTIFY g_powerSourceNotify = nullptr;
+static HPOWERNOTIFY g_displayNotify = nullptr;
+static HPOWERNOTIFY g_suspendResumeNotify = nullptr;
+static ULONGLONG g_lastWakeupReport = 0;
+static AdapterSnapshot g_adapters;  // Window thread only
+static NeighborInventory g_neighbors; // Window thread only
+static std::string g_reportBuffer;
+static int g_serverReportVersion = 1; // Announced in the server's pongs; reset per connection
+
+// Report shape 2 is {"v":2,"adapters":{...},"neighbors":[...]}; shape 1 is the bare adapter map
+static constexpr int REPORT_ENVELOPE_VERSION = 2;
+
+// ---------- Connection lifecycle wiring ----------
+static void SendMacAddresses();
+
+// Lifecycle timers are window timers; each is killed before it is dispatched, so they are one-shot
+class WindowClock : public ConnectionLifecycle::Clock {
+public:
+    ULONGLONG Now() override { return GetTickCount64(); }
+    void Arm(ConnectionLifecycle::Timer timer, ULONGLONG dueMs, ULONG toleranceMs) override {
+        SetCoalescableTimer(g_hWnd, TimerId(timer), static_cast<UINT>(dueMs), nullptr, toleranceMs);
+    }
+    void Cancel(ConnectionLifecycle::Timer timer) override {
+        KillTimer(g_hWnd, TimerId(timer));
+    }
+    static UINT_PTR TimerId(ConnectionLifecycle::Timer timer) {
+        switch (timer) {
+        case ConnectionLifecycle::Timer::Report: return IDT_MACSEND;
+        case ConnectionLifecycle::Timer::Heartbeat: return IDT_HEARTBEAT;
+        default: return IDT_PROBE;
+        }
+    }
+};
+
+class ClientTransport : public ConnectionLifecycle::Transport {
+public:
+    void SendReport() override { SendMacAddresses(); }
+    void Reconnect() override {
+        if (g_settings.IsValid()) g_wsClient.Reconnect();
+    }
+};
+
+static HeartbeatScheduler g_heartbeat(GetTickCount64());
+static WindowClock g_clock;
+static ClientTransport g_transport;
+static ConnectionLifecycle g_lifecycle(g_clock, g_transport, g_heartbeat);
 
 // ---------- Forward declarations ----------
 static LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
@@ -37,15 +96,32 @@ static void InitTrayIcon(HWND hWnd);
 static void RemoveTrayIcon();
 static void UpdateTrayIcon();
 static void ShowTrayMenu(HWND hWnd);
+static void ShowSettingsDialog();
+static void EnsureUi();
 static void StartConnection();
 static void StopConnection();
-static void SendMacAddresses();
+static void OnPowerSettingChange(const POWERBROADCAST_SETTING* setting);
+static void ReportWakeups();
 static void OnWebSocketMessage(const std::string& msg);
 static void OnWebSocketStateChanged(WebSocketClient::State state);
+static std::string HandleControlCommand(const std::string& command);
 static HICON CreateAppIcon(COLORREF color);
+static bool IsCommandLineMode(const wchar_t* arg);
+static int RunCommandLineMode(int argc, wchar_t** argv);
 
 // ---------- Entry point ----------
 int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE, _In_ LPWSTR, _In_ int) {
+    // Developer modes that run to completion on the console instead of the tray. Any other
+    // argument (from a shortcut, the Run key or a packaged activation) is ignored.
+    int argc = 0;
+    wchar_t** argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (argv && argc > 1 && IsCommandLineMode(argv[1])) {
+        int rc = RunCommandLineMode(argc, argv);
+        LocalFree(argv);
+        return rc;
+    }
+    if (argv) LocalFree(argv);
+
     // Single instance check
     HANDLE hMutex = CreateMutexW(nullptr, TRUE, g_mutexName);
     if (GetLastError() == ERROR_ALREADY_EXISTS) {
@@ -55,11 +131,12 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE, _In_ LPWSTR, _
 
     g_hInst = hInstance;
 
-    winrt::init_apartment(winrt::apartment_type::multi_threaded);
+    Log::Init();
+    LOG_INFO("WolSkill starting");
 
-    // Init common controls
-    INITCOMMONCONTROLSEX icc{ sizeof(icc), ICC_STANDARD_CLASSES };
-    InitCommonControlsEx(&icc);
+    // Settings first: low-memory mode decides what is loaded below
+    g_settings.Load();
+    Log::SetLevel(static_cast<Log::Level>(min(g_settings.logLevel, static_cast<DWORD>(Log::Level::Off))));
 
     // Register window class
     WNDCLASSEXW wc{};
@@ -78,8 +155,8 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE, _In_ LPWSTR, _
         return 1;
     }
 
-    // Opt into dark mode for menus before creating any UI
-    ThemeHelper::InitDarkMode();
+    // Low-memory mode defers comctl32, uxtheme and dwmapi (delay-loaded) until a menu or dialog opens
+    if (!g_settings.lowMemory) EnsureUi();
 
     // Create icons
     g_iconConnected = CreateAppIcon(RGB(0, 180, 80));    // green = connected
@@ -88,8 +165,24 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE, _In_ LPWSTR, _
     // Setup tray icon
     InitTrayIcon(g_hWnd);
 
-    // Load settings and connect
-    g_settings.Load();
+    // Track AC/battery and display state for the heartbeat interval
+    SYSTEM_POWER_STATUS sps{};
+    if (GetSystemPowerStatus(&sps))
+        g_heartbeat.SetOnBattery(sps.ACLineStatus == 0, GetTickCount64());
+    g_powerSourceNotify = RegisterPowerSettingNotification(g_hWnd, &GUID_ACDC_POWER_SOURCE, DEVICE_NOTIFY_WINDOW_HANDLE);
+    g_displayNotify = RegisterPowerSettingNotification(g_hWnd, &GUID_CONSOLE_DISPLAY_STATE, DEVICE_NOTIFY_WINDOW_HANDLE);
+    g_lastWakeupReport = GetTickCount64();
+
+    // Reconnect as soon as the machine resumes or the network path changes
+    g_suspendResumeNotify = RegisterSuspendResumeNotification(g_hWnd, DEVICE_NOTIFY_WINDOW_HANDLE);
+    NetworkMonitor::Start(g_hWnd, WM_NETWORK_CHANGED);
+
+    // Local status/control endpoint for scripts (see --ctl)
+    ControlChannel::StartServer(g_hWnd, WM_CONTROL_REQUEST);
+
+    // Connect
+    g_neighbors.SetNotify(g_hWnd, WM_NEIGHBORS_REFRESH);
+    g_neighbors.SetMode(static_cast<NeighborInventory::Mode>(g_settings.neighborScan));
     if (g_settings.IsValid()) {
         StartConnection();
     }
@@ -111,17 +204,145 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE, _In_ LPWSTR, _
     }
 
     // Cleanup
+    ControlChannel::StopServer();
+    g_neighbors.SetMode(NeighborInventory::Mode::Off);
+    NetworkMonitor::Stop();
+    if (g_suspendResumeNotify) UnregisterSuspendResumeNotification(g_suspendResumeNotify);
     StopConnection();
+    ReportWakeups();
+    if (g_powerSourceNotify) UnregisterPowerSettingNotification(g_powerSourceNotify);
+    if (g_displayNotify) UnregisterPowerSettingNotification(g_displayNotify);
     RemoveTrayIcon();
     ThemeHelper::Cleanup();
     if (g_iconConnected) DestroyIcon(g_iconConnected);
     if (g_iconDisconnected) DestroyIcon(g_iconDisconnected);
     if (g_editBrush) DeleteObject(g_editBrush);
+    LOG_INFO("WolSkill exiting");
+    Log::Shutdown();
     CloseHandle(hMutex);
 
     return static_cast<int>(msg.wParam);
 }
 
+// ---------- Command line modes ----------
+static constexpr const wchar_t* COMMAND_LINE_MODES[] = {
+    L"--simulate", L"--ctl", L"--ctl-bench", L"--check-budget", L"--bench-utf8",
+    L"--bench-log", L"--test-disconnect", L"--test-proxy", L"--help",
+};
+
+static bool IsCommandLineMode(const wchar_t* arg) {
+    for (const wchar_t* mode : COMMAND_LINE_MODES)
+        if (wcscmp(arg, mode) == 0) return true;
+    return false;
+}
+
+static int RunCommandLineMode(int argc, wchar_t** argv) {
+    // GUI subsystem: borrow the parent's console, or open one
+    if (!AttachConsole(ATTACH_PARENT_PROCESS)) AllocConsole();
+    FILE* out = nullptr;
+    freopen_s(&out, "CONOUT$", "w", stdout);
+
+    if (wcscmp(argv[1], L"--simulate") == 0) {
+        uint64_t seed = argc > 2 ? _wcstoui64(argv[2], nullptr, 10) : 1;
+        double days = argc > 3 ? _wtof(argv[3]) : 7.0;
+        int rc = Simulation::RunAll(seed, days > 0.0 ? days : 7.0);
+        std::fflush(stdout);
+        return rc;
+    }
+
+    if (wcscmp(argv[1], L"--ctl") == 0 && argc > 2) {
+        ControlChannel::Client client;
+        if (!client.Open(2000)) {
+            std::printf("WolSkill is not running (cannot open control pipe)\n");
+            std::fflush(stdout);
+            return 1;
+        }
+        char command[64];
+        WideCharToMultiByte(CP_UTF8, 0, argv[2], -1, command, sizeof(command), nullptr, nullptr);
+        std::string response;
+        bool ok = client.Transact(command, response);
+        std::printf("%s\n", response.c_str());
+        std::fflush(stdout);
+        return ok && response.find("\"error\"") == std::string::npos ? 0 : 1;
+    }
+
+    if (wcscmp(argv[1], L"--ctl-bench") == 0) {
+        // Round trips of "ping" through the pipe and the window's message loop
+        int count = argc > 2 ? _wtoi(argv[2]) : 1000;
+        if (count <= 0) count = 1000;
+        ControlChannel::Client client;
+        if (!client.Open(2000)) {
+            std::printf("WolSkill is not running (cannot open control pipe)\n");
+            std::fflush(stdout);
+            return 1;
+        }
+        LARGE_INTEGER freq, t0, t1;
+        QueryPerformanceFrequency(&freq);
+        std::vector<double> us;
+        us.reserve(count);
+        std::string response;
+        for (int i = 0; i < count; ++i) {
+            QueryPerformanceCounter(&t0);
+            if (!client.Transact("ping", response)) break;
+            QueryPerformanceCounter(&t1);
+            us.push_back(static_cast<double>(t1.QuadPart - t0.QuadPart) * 1e6 / static_cast<double>(freq.QuadPart));
+        }
+        if (us.empty()) return 1;
+        std::sort(us.begin(), us.end());
+        std::printf("%zu round trips: min %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us\n",
+            us.size(), us.front(), us[us.size() / 2], us[us.size() * 99 / 100], us.back());
+        std::fflush(stdout);
+        return 0;
+    }
+
+    if (wcscmp(argv[1], L"--check-budget") == 0) {
+        int cycles = argc > 2 ? _wtoi(argv[2]) : 100;
+        int rc = MemoryBudget::RunCheck(cycles > 0 ? cycles : 100, SendMacAddresses);
+        std::fflush(stdout);
+        return rc;
+    }
+
+    if (wcscmp(argv[1], L"--bench-utf8") == 0) {
+        int mib = argc > 2 ? _wtoi(argv[2]) : 256;
+        int rc = Utf8::RunBenchmark(mib > 0 ? static_cast<size_t>(mib) : 256);
+        std::fflush(stdout);
+        return rc;
+    }
+
+    if (wcscmp(argv[1], L"--bench-log") == 0) {
+        int count = argc > 2 ? _wtoi(argv[2]) : 1000000;
+        int rc = Log::RunBenchmark(count > 0 ? static_cast<size_t>(count) : 1000000);
+        std::fflush(stdout);
+        return rc;
+    }
+
+    if (wcscmp(argv[1], L"--test-disconnect") == 0) {
+        int rounds = argc > 2 ? _wtoi(argv[2]) : 20;
+        int rc = WebSocketClient::RunDisconnectTest(rounds > 0 ? rounds : 20);
+        std::fflush(stdout);
+        return rc;
+    }
+
+    if (wcscmp(argv[1], L"--test-proxy") == 0) {
+        int rounds = argc > 2 ? _wtoi(argv[2]) : 5;
+        int rc = WebSocketClient::RunProxyTest(rounds > 0 ? rounds : 5);
+        std::fflush(stdout);
+        return rc;
+    }
+
+    std::printf("Usage: WolSkill-cpp.exe [--help]\n"
+        "                        [--simulate [seed] [days]]\n"
+        "                        [--ctl status|ping|reconnect|report|reload]\n"
+        "                        [--ctl-bench [count]]\n"
+        "                        [--check-budget [cycles]]\n"
+        "                        [--bench-utf8 [MiB]]\n"
+        "                        [--bench-log [count]]\n"
+        "                        [--test-disconnect [rounds]]\n"
+        "                        [--test-proxy [rounds]]\n");
+    std::fflush(stdout);
+    return wcscmp(argv[1], L"--help") == 0 ? 0 : 2;
+}
+
 // ---------- Create a simple colored circle icon ----------
 static HICON CreateAppIcon(COLORREF color) {
     int cx = GetSystemMetrics(SM_CXSMICON);
@@ -197,20 +418,36 @@ static void RemoveTrayIcon() {
 }
 
 static void UpdateTrayIcon() {
-    g_nid.hIcon = g_connected ? g_iconConnected : g_iconDisconnected;
+    g_nid.hIcon = g_lifecycle.IsConnected() ? g_iconConnected : g_iconDisconnected;
     StringCchCopyW(g_nid.szTip, _countof(g_nid.szTip),
-        g_connected ? L"WolSkill - Connected" : L"WolSkill - Disconnected");
+        g_lifecycle.IsConnected() ? L"WolSkill - Connected" : L"WolSkill - Disconnected");
     Shell_NotifyIconW(NIM_MODIFY, &g_nid);
 }
 
+// Common controls and the dark-mode menu theme, loaded once before the first UI is shown
+static void EnsureUi() {
+    static bool initialized = false;
+    if (initialized) return;
+    INITCOMMONCONTROLSEX icc{ sizeof(icc), ICC_STANDARD_CLASSES };
+    InitCommonControlsEx(&icc);
+    ThemeHelper::InitDarkMode();
+    initialized = true;
+}
+
+static void ShowSettingsDialog() {
+    EnsureUi();
+    DialogBoxW(g_hInst, MAKEINTRESOURCEW(IDD_SETTINGS), nullptr, SettingsDlgProc);
+}
+
 static void ShowTrayMenu(HWND hWnd) {
+    EnsureUi();
     HMENU hMenu = CreatePopupMenu();
     if (!hMenu) return;
 
     // Status item (disabled, just informational)
     UINT statusFlags = MF_STRING | MF_GRAYED;
     AppendMenuW(hMenu, statusFlags, IDM_STATUS,
-        g_connected ? L"\x2705  Connected" : L"\x274C  Disconnected");
+        g_lifecycle.IsConnected() ? L"\x2705  Connected" : L"\x274C  Disconnected");
 
     AppendMenuW(hMenu, MF_SEPARATOR, 0, nullptr);
     AppendMenuW(hMenu, MF_STRING, IDM_SETTINGS, L"Settings...");
@@ -231,21 +468,195 @@ static void ShowTrayMenu(HWND hWnd) {
 static void StartConnection() {
     if (!g_settings.IsValid()) return;
     g_wsClient.SetCallbacks(OnWebSocketMessage, OnWebSocketStateChanged);
+    g_wsClient.SetProxyOverride(g_settings.proxy);
     g_wsClient.Connect(g_settings.awsId, g_settings.license);
 }
 
 static void StopConnection() {
-    KillTimer(g_hWnd, IDT_HEARTBEAT);
-    KillTimer(g_hWnd, IDT_MACSEND);
+    g_lifecycle.OnLocalStop();
     g_wsClient.Disconnect();
 }
 
+// Reused for every report, so steady-state reports do not touch the heap. The report is the
+// adapter map; with the neighbor inventory on and a server that announced report version 2,
+// it is the versioned envelope instead. A server that did not announce it never gets
+// neighbors. The neighbor table is not read here but on WM_NEIGHBORS_REFRESH.
 static void SendMacAddresses() {
-    std::string json = GetAdaptersJson();
-    g_wsClient.Send(json);
+    g_reportBuffer.clear();
+    Json::Writer writer(g_reportBuffer);
+    g_adapters.Refresh();
+    bool neighbors = g_neighbors.GetMode() != NeighborInventory::Mode::Off &&
+        g_serverReportVersion >= REPORT_ENVELOPE_VERSION;
+    writer.BeginObject();
+    if (neighbors) {
+        writer.Field<"v">(REPORT_ENVELOPE_VERSION);
+        writer.Key<"adapters">();
+        writer.BeginObject();
+    }
+    g_adapters.WriteMembers(writer);
+    if (neighbors) {
+        writer.EndObject();
+        writer.Key<"neighbors">();
+        g_neighbors.WriteJson(writer);
+    }
+    writer.EndObject();
+    g_wsClient.Send(g_reportBuffer);
+}
+
+static void OnPowerSettingChange(const POWERBROADCAST_SETTING* setting) {
+    if (setting->DataLength < sizeof(DWORD)) return;
+    DWORD value = *reinterpret_cast<const DWORD*>(setting->Data);
+    if (IsEqualGUID(setting->PowerSetting, GUID_ACDC_POWER_SOURCE)) {
+        // 0 = AC, 1 = battery, 2 = short-term source (UPS)
+        g_heartbeat.SetOnBattery(value != 0, GetTickCount64());
+    } else if (IsEqualGUID(setting->PowerSetting, GUID_CONSOLE_DISPLAY_STATE)) {
+        // 0 = off, 1 = on, 2 = dimmed
+        g_heartbeat.SetDisplayOn(value != 0, GetTickCount64());
+    }
+}
+
+static void ReportWakeups() {
+    ULONGLONG now = GetTickCount64();
+    for (int i = 0; i < static_cast<int>(HeartbeatScheduler::Mode::Count); ++i) {
+        auto mode = static_cast<HeartbeatScheduler::Mode>(i);
+        double rate = g_heartbeat.WakeupsPerHour(mode, now);
+        if (rate > 0.0)
+            LOG_INFO("Wakeups/h in {} mode: {}", HeartbeatScheduler::ModeName(mode), rate);
+    }
+    g_lastWakeupReport = now;
+
+    auto ds = g_wsClient.GetDispatchStats();
+    LOG_INFO("Dispatch: {} handled, max depth {}, max queue {} us, max handling {} us",
+        ds.handled, ds.maxDepth, ds.maxQueueUs, ds.maxHandleUs);
+
+    WebSocketClient::TransportStats ts;
+    if (g_wsClient.GetTransportStats(ts))
+        LOG_INFO("Transport: RTT {} us (min {} us), {} bytes retransmitted, {} timeouts",
+            ts.rttUs, ts.minRttUs, ts.bytesRetransmitted, ts.timeoutEpisodes);
 }
 
-// ---------- WebSocket callbacks (called from worker thread) ----------
+// ---------- Control channel (runs on the window thread) ----------
+static const char* StateName(WebSocketClient::State state) {
+    switch (state) {
+    case WebSocketClient::State::Connected: return "connected";
+    case WebSocketClient::State::Connecting: return "connecting";
+    default: return "disconnected";
+    }
+}
+
+static std::string HandleControlCommand(const std::string& command) {
+    if (command == "ping") return "{\"ok\":true}";
+
+    if (command == "status") {
+        ULONGLONG now = GetTickCount64();
+        ULONGLONG lastSend = g_lifecycle.LastSendTick();
+        auto ds = g_wsClient.GetDispatchStats();
+        std::string json;
+        Json::Writer w(json);
+        w.BeginObject();
+        w.Field<"state">(StateName(g_wsClient.GetState()));
+        w.Field<"reachable">(g_lifecycle.IsConnected());
+        w.Field<"healthScore">(g_wsClient.GetHealthScore());
+        w.Field<"heartbeatMode">(HeartbeatScheduler::ModeName(g_heartbeat.GetMode()));
+        w.Field<"reportIntervalMs">(g_heartbeat.ReportIntervalMs());
+        w.Field<"heartbeatTimeoutMs">(g_heartbeat.HeartbeatTimeoutMs());
+        w.Field<"idleTimeoutMs">(g_heartbeat.LearnedIdleTimeoutMs());
+        w.Field<"privateBytes">(MemoryBudget::PrivateBytes());
+        if (MemoryBudget::kCountsAllocations)
+            w.Field<"allocations">(MemoryBudget::AllocationCount());
+        w.Key<"lastReportAgoMs">();
+        if (lastSend) w.Number(now - lastSend);
+        else w.Null();
+        w.Key<"dispatch">();
+        w.BeginObject();
+        w.Field<"depth">(ds.depth);
+        w.Field<"handled">(ds.handled);
+        w.Field<"dropped">(ds.dropped);
+        w.Field<"waited">(ds.waited);
+        w.Field<"rejected">(ds.rejected);
+        w.Field<"discarded">(ds.discarded);
+        w.Field<"maxQueueUs">(ds.maxQueueUs);
+        w.Field<"maxHandleUs">(ds.maxHandleUs);
+        w.EndObject();
+        WebSocketClient::TransportStats ts;
+        if (g_wsClient.GetTransportStats(ts)) {
+            w.Key<"transport">();
+            w.BeginObject();
+            w.Field<"rttUs">(ts.rttUs);
+            w.Field<"minRttUs">(ts.minRttUs);
+            w.Field<"bytesRetransmitted">(ts.bytesRetransmitted);
+            w.Field<"timeoutEpisodes">(ts.timeoutEpisodes);
+            w.EndObject();
+        }
+        ProxyResolver::Route route = g_wsClient.GetProxyRoute();
+        if (route.resolvedTick) {
+            char proxy[256]{};
+            WideCharToMultiByte(CP_UTF8, 0, route.proxy.c_str(), -1, proxy, sizeof(proxy) - 1, nullptr, nullptr);
+            w.Key<"proxy">();
+            w.BeginObject();
+            w.Field<"source">(ProxyResolver::SourceName(route.source));
+            w.Field<"server">(proxy);
+            w.Field<"resolveMs">(route.resolveMs);
+            w.Field<"ageMs">(now - route.resolvedTick);
+            w.EndObject();
+        }
+        // Every handshake is timed, whether or not it waited for proxy resolution
+        auto ct = g_wsClient.GetConnectTimings();
+        if (ct.completedTick) {
+            w.Key<"handshake">();
+            w.BeginObject();
+            w.Field<"proxyCached">(ct.proxyCached);
+            w.Field<"viaProxy">(ct.viaProxy);
+            w.Field<"proxyUs">(ct.proxyUs);
+            w.Field<"connectUs">(ct.connectUs);
+            w.Field<"tunnelUs">(ct.tunnelUs);
+            w.Field<"upgradeUs">(ct.upgradeUs);
+            w.Field<"ageMs">(now - ct.completedTick);
+            w.EndObject();
+        }
+        w.Field<"reportVersion">(g_serverReportVersion);
+        w.Key<"adapters">();
+        g_adapters.Refresh();
+        w.BeginObject();
+        g_adapters.WriteMembers(w);
+        w.EndObject();
+        if (g_neighbors.GetMode() != NeighborInventory::Mode::Off) {
+            w.Key<"neighbors">();
+            g_neighbors.WriteJson(w);
+        }
+        w.EndObject();
+        return json;
+    }
+
+    if (command == "reconnect") {
+        if (!g_settings.IsValid()) return "{\"error\":\"not configured\"}";
+        LOG_INFO("Reconnect requested over control pipe");
+        g_wsClient.Reconnect();
+        return "{\"ok\":true}";
+    }
+
+    if (command == "report") {
+        if (g_wsClient.GetState() != WebSocketClient::State::Connected)
+            return "{\"error\":\"not connected\"}";
+        g_lifecycle.FlushReport();
+        return "{\"ok\":true}";
+    }
+
+    if (command == "reload") {
+        LOG_INFO("Settings reload requested over control pipe");
+        g_settings.Load();
+        Log::SetLevel(static_cast<Log::Level>(min(g_settings.logLevel, static_cast<DWORD>(Log::Level::Off))));
+        g_neighbors.SetMode(static_cast<NeighborInventory::Mode>(g_settings.neighborScan));
+        StopConnection();
+        StartConnection();
+        UpdateTrayIcon();
+        return "{\"ok\":true}";
+    }
+
+    return "{\"error\":\"unknown command\"}";
+}
+
+// ---------- WebSocket callbacks (messages on the dispatcher thread, state on the worker) ----------
 static void OnWebSocketMessage(const std::string& msg) {
     // Parse simple JSON to check for "pong" value
     // The server sends: {"value":"pong"} or {"value":"XX-XX-XX-XX-XX-XX"}
@@ -265,27 +676,31 @@ static void OnWebSocketMessage(const std::string& msg) {
     }
 
     if (value == "pong") {
+        // A server that accepts newer report shapes says so: {"value":"pong","report":2}
+        long reportVersion = 1;
+        pos = msg.find("\"report\":");
+        if (pos != std::string::npos) reportVersion = strtol(msg.c_str() + pos + 9, nullptr, 10);
         // Reset heartbeat timer and schedule MAC send
-        PostMessageW(g_hWnd, WM_WS_STATUS_CHANGED, 1, 0); // 1 = pong received
+        PostMessageW(g_hWnd, WM_WS_STATUS_CHANGED, 1, reportVersion > 1 ? reportVersion : 1); // 1 = pong received
     } else if (!value.empty()) {
         // Check if the value matches any local MAC address
-        auto macs = GetLocalMacAddresses();
-        for (auto& mac : macs) {
-            if (value == mac) {
-                // Trigger shutdown (matching the Node.js behavior)
-                HANDLE hToken;
-                if (OpenProcessToken(GetCurrentProcess(),
-                    TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken)) {
-                    TOKEN_PRIVILEGES tp;
-                    LookupPrivilegeValueW(nullptr, SE_SHUTDOWN_NAME, &tp.Privileges[0].Luid);
-                    tp.PrivilegeCount = 1;
-                    tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
-                    AdjustTokenPrivileges(hToken, FALSE, &tp, 0, nullptr, nullptr);
-                    CloseHandle(hToken);
-                }
-                ExitWindowsEx(EWX_SHUTDOWN | EWX_FORCE, SHTDN_REASON_FLAG_PLANNED);
-                break;
+        AdapterSnapshot adapters;
+        if (adapters.Refresh() && adapters.HasMac(value)) {
+            // Trigger shutdown (matching the Node.js behavior)
+            LOG_WARN("Shutdown requested by server for a local MAC address");
+            HANDLE hToken;
+            if (OpenProcessToken(GetCurrentProcess(),
+                TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken)) {
+                TOKEN_PRIVILEGES tp;
+                LookupPrivilegeValueW(nullptr, SE_SHUTDOWN_NAME, &tp.Privileges[0].Luid);
+                tp.PrivilegeCount = 1;
+                tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+                AdjustTokenPrivileges(hToken, FALSE, &tp, 0, nullptr, nullptr);
+                CloseHandle(hToken);
             }
+            // The session ends before the next periodic flush would write the line above
+            Log::Flush();
+            ExitWindowsEx(EWX_SHUTDOWN | EWX_FORCE, SHTDN_REASON_FLAG_PLANNED);
         }
     }
 }
@@ -371,7 +786,7 @@ static LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPara
             ShowTrayMenu(hWnd);
             break;
         case WM_LBUTTONDBLCLK:
-            DialogBoxW(g_hInst, MAKEINTRESOURCEW(IDD_SETTINGS), nullptr, SettingsDlgProc);
+            ShowSettingsDialog();
             break;
         }
         return 0;
@@ -379,7 +794,7 @@ static LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPara
     case WM_COMMAND:
         switch (LOWORD(wParam)) {
         case IDM_SETTINGS:
-            DialogBoxW(g_hInst, MAKEINTRESOURCEW(IDD_SETTINGS), nullptr, SettingsDlgProc);
+            ShowSettingsDialog();
             break;
         case IDM_STARTUP:
             Settings::SetRunOnStartup(!Settings::IsRunOnStartup());
@@ -393,42 +808,73 @@ static LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPara
     case WM_WS_STATUS_CHANGED:
         switch (wParam) {
         case 0: // Disconnected
-            g_connected = false;
-            KillTimer(hWnd, IDT_HEARTBEAT);
-            KillTimer(hWnd, IDT_MACSEND);
-            UpdateTrayIcon();
+            g_serverReportVersion = 1;
+            g_lifecycle.OnDisconnected();
             break;
-        case 1: // Pong received - reset heartbeat, schedule MAC send
-            g_connected = true;
-            SetTimer(hWnd, IDT_HEARTBEAT, 40000, nullptr);
-            KillTimer(hWnd, IDT_MACSEND);
-            SetTimer(hWnd, IDT_MACSEND, 30000, nullptr);
-            UpdateTrayIcon();
+        case 1: // Pong received - reset heartbeat, schedule MAC send; lParam = report version
+            if (static_cast<int>(lParam) != g_serverReportVersion) {
+                g_serverReportVersion = static_cast<int>(lParam);
+                LOG_INFO("Server accepts report version {}", g_serverReportVersion);
+            }
+            g_lifecycle.OnPong();
             break;
         case 2: // Connected - send MACs immediately, start heartbeat
-            g_connected = true;
-            SendMacAddresses();
-            SetTimer(hWnd, IDT_HEARTBEAT, 40000, nullptr);
-            SetTimer(hWnd, IDT_MACSEND, 30000, nullptr);
-            UpdateTrayIcon();
+            g_serverReportVersion = 1;
+            g_lifecycle.OnConnected();
             break;
         }
+        UpdateTrayIcon();
         return 0;
 
     case WM_TIMER:
+        g_heartbeat.OnWakeup();
+        if (GetTickCount64() - g_lastWakeupReport >= 60 * 60 * 1000)
+            ReportWakeups();
+        KillTimer(hWnd, wParam);
         switch (wParam) {
         case IDT_HEARTBEAT:
-            // Heartbeat timeout: no pong received in 40s
-            // The WebSocket client auto-reconnects, so just update status
-            g_connected = false;
-            KillTimer(hWnd, IDT_HEARTBEAT);
-            KillTimer(hWnd, IDT_MACSEND);
+            g_lifecycle.OnTimer(ConnectionLifecycle::Timer::Heartbeat);
             UpdateTrayIcon();
             break;
-        case IDT_MACSEND:
-            SendMacAddresses();
+        case IDT_PROBE:
+            g_lifecycle.OnTimer(ConnectionLifecycle::Timer::Probe);
             break;
+        case IDT_MACSEND: {
+            // Only this thread's allocations: the log, sweep and WinHTTP threads run meanwhile
+            uint64_t allocations = MemoryBudget::ThreadAllocationCount();
+            g_lifecycle.OnTimer(ConnectionLifecycle::Timer::Report);
+            if (g_settings.lowMemory)
+                MemoryBudget::OnReportCycle(MemoryBudget::ThreadAllocationCount() - allocations);
+            break;
+        }
+        case IDT_NETCHANGE:
+            g_neighbors.RequestSweep();
+            g_wsClient.OnNetworkChanged();
+            if (g_settings.IsValid()) g_lifecycle.OnNetworkSettled();
+            break;
+        }
+        return 0;
+
+    case WM_POWERBROADCAST:
+        if (wParam == PBT_POWERSETTINGCHANGE) {
+            OnPowerSettingChange(reinterpret_cast<const POWERBROADCAST_SETTING*>(lParam));
+        } else if (wParam == PBT_APMRESUMEAUTOMATIC) {
+            g_lifecycle.OnResume();
         }
+        return TRUE;
+
+    case WM_NETWORK_CHANGED:
+        // Restarting the timer debounces bursts of interface/address/route notifications
+        g_lifecycle.OnNetworkEvent();
+        SetTimer(hWnd, IDT_NETCHANGE, ReconnectPolicy::kNetworkDebounceMs, nullptr);
+        return 0;
+
+    case WM_NEIGHBORS_REFRESH:
+        g_neighbors.Refresh();
+        return 0;
+
+    case WM_CONTROL_REQUEST:
+        ControlChannel::Respond(lParam, HandleControlCommand(ControlChannel::Command(lParam)));
         return 0;
 
     case WM_SETTINGCHANGE:
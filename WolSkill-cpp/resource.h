@@ -7,6 +7,9 @@
 // System tray
 #define WM_TRAYICON              (WM_USER + 1)
 #define WM_WS_STATUS_CHANGED     (WM_USER + 2)
+#define WM_NETWORK_CHANGED       (WM_USER + 3)
+#define WM_CONTROL_REQUEST       (WM_USER + 4)
+#define WM_NEIGHBORS_REFRESH     (WM_USER + 5)
 
 // Tray menu items
 #define IDM_STATUS               2001
@@ -27,3 +30,5 @@
 #define IDT_HEARTBEAT            4001
 #define IDT_MACSEND              4002
 #define IDT_RECONNECT            4003
+#define IDT_NETCHANGE            4004
+#define IDT_PROBE                4005